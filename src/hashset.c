@@ -1,51 +1,209 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "hashset.h"
+#include "hashset_typed.h"
 #include "bitset.h"
 #include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MADVISE)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_SYS_SYSCALL_H) && defined(HAVE_LINUX_MEMPOLICY_H)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #define ALIGNMENT sizeof(size_t)
-#define BIT_FIELD_LEN 2
-#define LARGE_PRIME 0x7fffffffu
+#define BIT_FIELD_LEN HS_USAGE_BITS
+#define FILTER_MAX_HASHES 16
+#define LN2 0.69314718055994530942
+#define HUGE_PAGE_SIZE (2u << 20)
+#define EXPORT_MIN_CHUNK 4096 /* slots per export thread */
+#define EXPORT_MAX_THREADS 64
+#define CUCKOO_MAX_NODES 512 /* buckets inspected by displacement search before growing */
+#define CUCKOO_SLACK 8       /* reserve extra 1/8 of capacity in cuckoo mode */
+#define BENCH_MIN_NS 1e7     /* hashfunc is timed for at least 10ms */
+#define GALLOP_RATIO 8 /* size ratio from which intersection searches instead of merging */
+#define MIGRATE_BATCH 1024   /* slots copied by the resize thread per lock acquisition */
+
+/*
+* Bucket reached by the cuckoo displacement search,
+* `victim` is a slot of the `parent` bucket whose value would move here.
+*/
+typedef struct cuckoo_node
+{
+    size_t bucket;
+    size_t victim; /* `capacity` for the value's own buckets */
+    size_t parent;
+}
+cuckoo_node_t;
+
+/*
+* Values placed by a bulk insertion so far, removed again if it fails.
+* `values` is NULL when inserts into the reserved table can't fail.
+*/
+typedef struct bulk_log
+{
+    const void **values;
+    size_t count;
+}
+bulk_log_t;
+
+typedef enum merge_op
+{
+    MERGE_UNION,
+    MERGE_INTERSECTION,
+    MERGE_DIFF,
+    MERGE_SYMDIFF
+}
+merge_op_t;
+
+/*
+* Portion of the table handled by one export thread.
+*/
+typedef struct export_chunk
+{
+    const hashset_t *set;
+    char *dst;
+    size_t stride;
+    size_t begin, end; /* slot range */
+    size_t offset;     /* first output position */
+    size_t count;      /* amount of used slots in range */
+}
+export_chunk_t;
+
+/*
+* Background copy of the table into `target`. Slots below `cursor` are
+* already copied, so foreground changes to them are repeated in `target`.
+* Both tables are modified only under `lock`. Migration belongs to one table
+* at a time, handles take it over by atomic exchange of the header pointer.
+*/
+typedef struct migration
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    hashset_t *source;
+    hashset_t *target;
+    size_t cursor;
+    atomic_bool cancel;
+    atomic_bool done;
+    bool failed;
+}
+migration_t;
 
 typedef struct hs_header
 {
+    atomic_size_t refs;  /* amount of handles sharing this table (copy-on-write) */
     size_t value_size;
+    size_t element_size; /* slot size, equals `value_size` when packed */
     hashfunc_t hashfunc;
+    hs_probing_t probing;
+
+    size_t count;           /* amount of used slots */
+    size_t deleted;         /* amount of tombstones */
+    uint64_t digest;        /* sum of mixed hashes of all elements */
+    size_t min_cap;         /* auto shrink never goes below initial capacity */
+    float min_load_factor;  /* auto shrink threshold, 0 - disabled */
 
     unsigned int a; /* random factors for multiplicative hashing */
     unsigned int b;
 
+    bool huge_pages;         /* table placement, kept for rehash and clone */
+    hs_numa_policy_t numa_policy;
+    int numa_node;
+
+    float filter_fp_rate;    /* requested filter parameters, kept for rehash */
+    size_t filter_max_bytes;
+    size_t filter_bits;      /* bloom filter size, located after the usage table */
+    unsigned int filter_hashes;
+
+    bool background;         /* resize on a helper thread */
+    _Atomic(migration_t *) migration; /* ongoing background resize, NULL if none */
+
     char usage_tbl[];
 }
 hs_header_t;
 
-typedef enum hs_slot_status
-{
-    HS_SLOT_UNUSED = 0,
-    HS_SLOT_USED,
-    HS_SLOT_DELETED
-}
-hs_slot_status_t;
-
-
 /***                          ***
 * === forward declarations  === *
 ***                          ***/
 
 static size_t calc_usage_tbl_size(const size_t capacity);
+static size_t calc_element_size(const size_t value_size, const bool packed);
+static size_t calc_cuckoo_capacity(const size_t capacity);
+static size_t calc_filter_bits(const size_t capacity, const float fp_rate, const size_t max_bytes);
+static unsigned int calc_filter_hashes(const size_t capacity, const size_t filter_bits);
 
 static hs_header_t *get_hs_header(const hashset_t *const set);
-
+static hs_opts_t get_opts(const hashset_t *const set);
+static char *get_filter(const hashset_t *const set);
+static uint64_t mix_hash(const hash_t hash);
+static void filter_add(hashset_t *const set, const hash_t hash);
+static bool filter_test(const hashset_t *const set, const hash_t hash);
+
+static hash_t hash_value(const hs_header_t *const header, const void *const value);
+static size_t find_slot(const hashset_t *const set, const void *const value, const hash_t hash);
+static hs_status_t insert_value(hashset_t **const set, const void *const value, const hash_t hash);
+static void release_slot(hashset_t *const set, const size_t index, const hash_t hash);
+static hs_status_t occupy_slot(hashset_t **const set, const size_t index,
+        const void *const value, const hash_t hash);
+static void cuckoo_buckets(const hs_header_t *const header, const hash_t hash,
+        const size_t capacity, size_t buckets[2]);
+static size_t cuckoo_free_slot(const hs_header_t *const header, const size_t bucket, const size_t capacity);
+static hs_status_t cuckoo_place(hashset_t **const set, const void *const value, const hash_t hash);
+static hs_status_t cuckoo_insert(hashset_t **const set, const void *const value, const hash_t hash);
 static size_t hash_to_index(const hs_header_t *header, const hash_t hash, const size_t capacity);
 static void set_value(hashset_t *const set, const size_t index, const void *const value);
 static char *get_value(const hashset_t *const set, const size_t index);
 
-static void randomize_factors(hs_header_t *const header);
+static const void *next_value(const hashset_t *const set, size_t *const slot);
+static const void *view_next_in(hs_view_t *const view, const hashset_t *const walk,
+        const hashset_t *const probe, const bool want);
+
+static hashset_t *create_like(const hashset_t *const proto, const size_t capacity);
+static hashset_t *make_from_view(const hashset_t *const proto, hs_view_t view);
+static hs_status_t make_unique(hashset_t **const set);
+static void place_table(const hashset_t *const set);
+static size_t export_values(const hashset_t *const set, void *const dst,
+        const size_t stride, size_t threads);
+static void *export_count(void *const param);
+static void *export_copy(void *const param);
+static void run_chunks(export_chunk_t *const chunks, const size_t amount, void *(*job)(void*));
+static size_t merge(const char *a, const size_t a_len, const char *b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, char *out, const merge_op_t op);
+static size_t gallop_intersection(const char *small, const size_t small_len, const char *large, const size_t large_len,
+        const size_t value_size, const hs_compare_t compare, char *out);
+static void randomize_factors(unsigned int *const a, unsigned int *const b);
+static double elapsed_ns(const struct timespec *const since);
+static size_t reserve_capacity(const hashset_t *const set, size_t count);
+static hs_status_t begin_bulk_insert(hashset_t **const set, const size_t missing, bulk_log_t *const log);
+static hs_status_t bulk_insert(hashset_t **const set, const void *const value, bulk_log_t *const log);
+static hs_status_t end_bulk_insert(hashset_t **const set, bulk_log_t *const log, const hs_status_t status);
+static hs_status_t rebuild(const hashset_t *const set, const size_t new_cap, hashset_t **const out);
 static hs_status_t rehash(hashset_t **const set, const size_t new_cap);
+static size_t shrink_target(const hashset_t *const set);
+static void shrink_if_sparse(hashset_t **const set);
+static void schedule_resize(hashset_t **const set, const size_t new_cap);
+static void *migrate(void *const param);
+static void finish_migration(hashset_t **const set, const bool wait);
+static void cancel_migration(const hashset_t *const set);
+static bool keep_migration(const hashset_t *const set, const size_t min_cap);
+static void stop_migration(migration_t *const migration);
 static bool contained_in(const void *const element, void *const param);
 static bool not_contained_in(const void *const element, void *const param);
-static bool contained_in_both(const void *const element, void *const param);
 
 
 /***                       ***
@@ -58,14 +216,21 @@ hashset_t *hs_create_(const hs_opts_t *const opts)
     assert(opts->value_size && "value_size wasn't provided");
     assert(opts->hashfunc && "hashfunc wasn't provided");
 
-    const size_t aligned_value_size = calc_aligned_size(opts->value_size, ALIGNMENT);
-    const size_t usage_tbl_size = calc_usage_tbl_size(opts->initial_cap);
+    const size_t capacity = HS_PROBING_CUCKOO == opts->probing
+        ? calc_cuckoo_capacity(opts->initial_cap)
+        : opts->initial_cap;
+
+    const size_t element_size = calc_element_size(opts->value_size, opts->packed);
+    const size_t usage_tbl_size = calc_usage_tbl_size(capacity);
+    const size_t filter_bits = calc_filter_bits(capacity,
+        opts->filter_fp_rate, opts->filter_max_bytes);
+    const size_t filter_size = calc_aligned_size(filter_bits / BYTE, ALIGNMENT);
 
     /* allocate storage for hashset */
     hashset_t *set = vector_create(
-        .data_offset = sizeof(hs_header_t) + usage_tbl_size,
-        .initial_cap = opts->initial_cap,
-        .element_size = aligned_value_size,
+        .data_offset = sizeof(hs_header_t) + usage_tbl_size + filter_size,
+        .initial_cap = capacity,
+        .element_size = element_size,
         .alloc_param = opts->alloc_param,
     );
     
@@ -76,11 +241,26 @@ hashset_t *hs_create_(const hs_opts_t *const opts)
 
     *header = (hs_header_t){
        .value_size = opts->value_size,
-       .hashfunc = opts->hashfunc
+       .element_size = element_size,
+       .hashfunc = opts->hashfunc,
+       .probing = opts->probing,
+       .min_cap = capacity,
+       .min_load_factor = opts->min_load_factor,
+       .huge_pages = opts->huge_pages,
+       .numa_policy = opts->numa_policy,
+       .numa_node = opts->numa_node,
+       .filter_fp_rate = opts->filter_fp_rate,
+       .filter_max_bytes = opts->filter_max_bytes,
+       .filter_bits = filter_bits,
+       .filter_hashes = calc_filter_hashes(capacity, filter_bits),
+       .background = opts->background_resize && HS_PROBING_LINEAR == opts->probing,
     };
 
+    atomic_init(&header->refs, 1);
     bitset_init(header->usage_tbl, usage_tbl_size);
-    randomize_factors(header);
+    memset(get_filter(set), 0, filter_size);
+    randomize_factors(&header->a, &header->b);
+    place_table(set);
 
     return set;
 }
@@ -89,14 +269,22 @@ hashset_t *hs_create_(const hs_opts_t *const opts)
 hashset_t *hs_clone(const hashset_t *const set)
 {
     assert(set);
-    return vector_clone(set);
+
+    /* table is shared until one of the handles gets modified */
+    atomic_fetch_add_explicit(&get_hs_header(set)->refs, 1, memory_order_relaxed);
+    return (hashset_t*)set;
 }
 
 
 void hs_destroy(hashset_t *const set)
 {
     assert(set);
-    vector_destroy(set);
+
+    if (1 == atomic_fetch_sub_explicit(&get_hs_header(set)->refs, 1, memory_order_acq_rel))
+    {
+        cancel_migration(set);
+        vector_destroy(set);
+    }
 }
 
 
@@ -106,68 +294,92 @@ bool hs_contains(const hashset_t *const set, const void *const value)
     assert(value);
 
     const hs_header_t* header = get_hs_header(set);
-    const size_t capacity = hs_capacity(set);
-    const size_t start_index = hash_to_index(header,
-        header->hashfunc(value, header->value_size),
-        capacity);
+    const hash_t hash = hash_value(header, value);
 
-    for (size_t i = 0; i < capacity; ++i)
-    {
-        const size_t index = (i + start_index) % capacity;
-        const hs_slot_status_t slot_stat = bitset_test(header->usage_tbl, BIT_FIELD_LEN, index);
-        switch (slot_stat)
-        {
-            case HS_SLOT_UNUSED: return false;
+    if (!filter_test(set, hash)) return false;
 
-            case HS_SLOT_USED:
-                if (0 == memcmp(get_value(set, index), value, header->value_size))
-                {
-                    return true;
-                }
-                break;
+    return hs_capacity(set) != find_slot(set, value, hash);
+}
 
-            case HS_SLOT_DELETED: continue;
-        }
-    }
 
-    return false;
+hs_status_t hs_insert(hashset_t **set, const void *const value)
+{
+    assert(set && *set);
+    assert(value);
+
+    return hs_insert_hashed(set, value, hash_value(get_hs_header(*set), value));
 }
 
 
-hs_status_t hs_insert(hashset_t **set, const void *const value)
+hs_status_t hs_insert_hashed(hashset_t **const set, const void *const value, const hash_t hash)
 {
     assert(set && *set);
     assert(value);
 
-    hs_header_t* header = get_hs_header(*set);
-    const size_t capacity = hs_capacity(*set);
-    const size_t start_index = hash_to_index(header,
-        header->hashfunc(value, header->value_size),
-        capacity);
+    finish_migration(set, false);
 
-    for (size_t i = 0; i < capacity; ++i)
+    const hs_status_t status = insert_value(set, value, hash);
+    if (HS_SUCCESS != status) return status;
+
+    /* start growing in the background before the table gets full */
+    const hs_header_t *header = get_hs_header(*set);
+    const size_t capacity = hs_capacity(*set);
+    if (4 * (header->count + header->deleted) >= 3 * capacity)
     {
-        const size_t index = (i + start_index) % capacity;
-        const hs_slot_status_t slot_stat = bitset_test(header->usage_tbl, BIT_FIELD_LEN, index);
-        if (HS_SLOT_USED != slot_stat)
-        {
-            bitset_set(header->usage_tbl, BIT_FIELD_LEN, index, HS_SLOT_USED);
-            set_value(*set, index, value);
-            return HS_SUCCESS;
-        }
-        else if (0 == memcmp(value, get_value(*set, index), header->value_size))
-        {
-            return HS_ALREADY_EXISTS;
-        }
+        schedule_resize(set, 2 * header->count >= capacity ? 2 * capacity : capacity);
     }
 
-    const size_t new_capacity = 2 * hs_capacity(*set);
+    return HS_SUCCESS;
+}
+
+
+hs_status_t hs_insert_many(hashset_t **const set, const void *const values, const size_t count)
+{
+    assert(set && *set);
+    assert(values || 0 == count);
+
+    const size_t value_size = get_hs_header(*set)->value_size;
+    const char *value = values;
+    size_t missing = 0;
+
+    for (size_t i = 0; i < count; ++i, value += value_size)
+    {
+        if (!hs_contains(*set, value)) ++missing;
+    }
+    if (0 == missing) return HS_SUCCESS;
 
-    hs_status_t status = rehash(set, new_capacity);
+    bulk_log_t log;
+    hs_status_t status = begin_bulk_insert(set, missing, &log);
     if (HS_SUCCESS != status) return status;
 
-    (void) hs_insert(set, value);
-    return HS_SUCCESS;
+    value = values;
+    for (size_t i = 0; HS_SUCCESS == status && i < count; ++i, value += value_size)
+    {
+        status = bulk_insert(set, value, &log);
+    }
+
+    return end_bulk_insert(set, &log, status);
+}
+
+
+hs_status_t hs_reserve(hashset_t **const set, size_t count)
+{
+    assert(set && *set);
+
+    finish_migration(set, false);
+    const size_t new_cap = reserve_capacity(*set, count);
+
+    /* growth in progress already makes the room, other resizes would take it back */
+    if (keep_migration(*set, new_cap))
+    {
+        if (count <= hs_capacity(*set)) return HS_SUCCESS;
+        finish_migration(set, true);
+        if (hs_capacity(*set) >= new_cap) return HS_SUCCESS;
+    }
+
+    if (hs_capacity(*set) == new_cap) return HS_SUCCESS;
+
+    return rehash(set, new_cap);
 }
 
 
@@ -183,60 +395,63 @@ hs_status_t hs_shrink_reserve(hashset_t **const set, const float reserve)
 }
 
 
-void hs_remove(hashset_t *const set, const void *const value)
+hs_status_t hs_remove(hashset_t **const set, const void *const value)
 {
-    assert(set);
+    assert(set && *set);
     assert(value);
 
-    hs_header_t* header = get_hs_header(set);
-    const size_t capacity = vector_capacity(set);
-    const size_t start_index = hash_to_index(header,
-        header->hashfunc(value, header->value_size),
-        capacity);
+    return hs_remove_hashed(set, value, hash_value(get_hs_header(*set), value));
+}
 
-    for (size_t i = 0; i < capacity; ++i)
-    {
-        const size_t index = (i + start_index) % capacity;
-        const hs_slot_status_t slot_stat = bitset_test(header->usage_tbl, BIT_FIELD_LEN, index);
-        switch (slot_stat)
-        {
-            case HS_SLOT_UNUSED:
-                return;
 
-            case HS_SLOT_USED:
-                if (0 == memcmp(value, get_value(set, index), header->value_size))
-                {
-                    bitset_set(header->usage_tbl, BIT_FIELD_LEN, index, HS_SLOT_DELETED);
-                    return;
-                }
-                break;
+hs_status_t hs_remove_hashed(hashset_t **const set, const void *const value, const hash_t hash)
+{
+    assert(set && *set);
+    assert(value);
 
-            case HS_SLOT_DELETED:
-                continue;
-        }
-    }
+    finish_migration(set, false);
+
+    const size_t index = find_slot(*set, value, hash);
+    if (hs_capacity(*set) == index) return HS_SUCCESS;
+
+    if (HS_SUCCESS != make_unique(set)) return HS_ALLOC_ERROR;
+
+    release_slot(*set, index, hash);
+    shrink_if_sparse(set);
+    return HS_SUCCESS;
 }
 
 
-size_t hs_remove_many(hashset_t *const set, const predicate_t predicate, void *const param)
+size_t hs_remove_many(hashset_t **const set, const predicate_t predicate, void *const param)
 {
-    assert(set);
+    assert(set && *set);
     assert(predicate);
 
-    hs_header_t *header = get_hs_header(set);
-    const size_t capacity = hs_capacity(set);
+    finish_migration(set, false);
+
+    hs_header_t *header = get_hs_header(*set);
+    const size_t capacity = hs_capacity(*set);
     size_t removes = 0;
 
     for (size_t i = 0; i < capacity; ++i)
     {
         if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, i)
-            && predicate(get_value(set, i), param))
+            && predicate(get_value(*set, i), param))
         {
-            bitset_set(header->usage_tbl, BIT_FIELD_LEN, i, HS_SLOT_DELETED);
+            /* shared table is copied on the first match */
+            if (0 == removes)
+            {
+                if (HS_SUCCESS != make_unique(set)) return 0;
+                header = get_hs_header(*set);
+            }
+
+            release_slot(*set, i, hash_value(header, get_value(*set, i)));
             ++removes;
         }
     }
 
+    if (removes) shrink_if_sparse(set);
+
     return removes;
 }
 
@@ -246,38 +461,67 @@ hs_status_t hs_add(hashset_t **const set, const hashset_t *const other)
     assert(set && *set);
     assert(other);
 
+    hs_view_t missing = hs_view_diff(other, *set);
+    const size_t missing_count = hs_view_count(&missing);
+    if (0 == missing_count) return HS_SUCCESS;
+
+    bulk_log_t log;
+    hs_status_t status = begin_bulk_insert(set, missing_count, &log);
+    if (HS_SUCCESS != status) return status;
+
     hs_header_t *other_header = get_hs_header(other);
     const size_t other_cap = hs_capacity(other);
 
-    for (size_t i = 0; i < other_cap; ++i)
+    for (size_t i = 0; HS_SUCCESS == status && i < other_cap; ++i)
     {
         if (HS_SLOT_USED == bitset_test(other_header->usage_tbl, BIT_FIELD_LEN, i))
         {
-            /* FIXME: if insert failes, `set` will stay in invalid halfmodified state */
-            hs_status_t status = hs_insert(set, get_value(other, i));
-            if (status == HS_ALLOC_ERROR) return status;
+            status = bulk_insert(set, get_value(other, i), &log);
         }
     }
 
-    return HS_SUCCESS;
+    return end_bulk_insert(set, &log, status);
 }
 
 
-void hs_intersect(hashset_t **const set, const hashset_t *const other)
+hs_status_t hs_intersect(hashset_t **const set, const hashset_t *const other)
 {
     assert(set && *set);
     assert(other);
 
-    (void) hs_remove_many(*set, not_contained_in, (void*)other);
+    if (1 == atomic_load(&get_hs_header(*set)->refs))
+    {
+        (void) hs_remove_many(set, not_contained_in, (void*)other);
+        return HS_SUCCESS;
+    }
+
+    /* shared table: build the result instead of copying and removing */
+    hashset_t *result = make_from_view(*set, hs_view_intersection(*set, other));
+    if (!result) return HS_ALLOC_ERROR;
+
+    hs_destroy(*set);
+    *set = result;
+    return HS_SUCCESS;
 }
 
 
-void hs_subtract(hashset_t **const set, const hashset_t *const other)
+hs_status_t hs_subtract(hashset_t **const set, const hashset_t *const other)
 {
     assert(set && *set);
     assert(other);
 
-    (void) hs_remove_many(*set, contained_in, (void*)other);
+    if (1 == atomic_load(&get_hs_header(*set)->refs))
+    {
+        (void) hs_remove_many(set, contained_in, (void*)other);
+        return HS_SUCCESS;
+    }
+
+    hashset_t *result = make_from_view(*set, hs_view_diff(*set, other));
+    if (!result) return HS_ALLOC_ERROR;
+
+    hs_destroy(*set);
+    *set = result;
+    return HS_SUCCESS;
 }
 
 
@@ -286,6 +530,7 @@ hashset_t *hs_make_union(hashset_t *const first, const hashset_t *const second)
     assert(first);
     assert(second);
 
+    /* shares `first` table if `second` brings nothing new */
     hashset_t *result = hs_clone(first);
 
     if (HS_SUCCESS != hs_add(&result, second))
@@ -303,9 +548,7 @@ hashset_t *hs_make_intersection(hashset_t *const first, const hashset_t *const s
     assert(first);
     assert(second);
 
-    hashset_t *result = hs_clone(first);
-    hs_intersect(&result, second);
-    return result;
+    return make_from_view(first, hs_view_intersection(first, second));
 }
 
 
@@ -314,181 +557,1702 @@ hashset_t *hs_make_diff(hashset_t *const first, const hashset_t *const second)
     assert(first);
     assert(second);
 
-    hashset_t *result = hs_clone(first);
-    hs_subtract(&result, second);
-    return result;
+    return make_from_view(first, hs_view_diff(first, second));
 }
 
 
-struct two_sets
-{
-    const hashset_t *const a, *const b;
-};
-
 hashset_t *hs_make_symdiff(hashset_t *const first, const hashset_t *const second)
 {
     assert(first);
     assert(second);
 
-    hashset_t *result = hs_make_union(first, second);
-    struct two_sets sets = {first, second};
-    hs_remove_many(result, contained_in_both, &sets);
-    return result;
+    return make_from_view(first, hs_view_symdiff(first, second));
 }
 
 
-size_t hs_capacity(const hashset_t *const set)
+hs_view_t hs_view_union(const hashset_t *const first, const hashset_t *const second)
 {
-    assert(set);
-
-    return vector_initial_capacity(set);
+    assert(first);
+    assert(second);
+    return (hs_view_t){.kind = HS_VIEW_UNION, .first = first, .second = second};
 }
 
 
-size_t hs_count(const hashset_t *const set)
+hs_view_t hs_view_intersection(const hashset_t *const first, const hashset_t *const second)
 {
-    assert(set);
-
-    const size_t capacity = hs_capacity(set);
-    const hs_header_t *header = get_hs_header(set);
-    size_t count = 0;
+    assert(first);
+    assert(second);
 
-    for (size_t i = 0; i < capacity; ++i)
+    /* walk the smaller set, probe the larger one */
+    if (hs_count(first) > hs_count(second))
     {
-        if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, i))
-        {
-            ++count;
-        }
+        return (hs_view_t){.kind = HS_VIEW_INTERSECTION, .first = second, .second = first};
     }
-    return count;
+    return (hs_view_t){.kind = HS_VIEW_INTERSECTION, .first = first, .second = second};
 }
 
 
-vector_t *hs_values(const hashset_t *const set)
+hs_view_t hs_view_diff(const hashset_t *const first, const hashset_t *const second)
 {
-    assert(set);
-
-    const hs_header_t *header = get_hs_header(set);
-    const size_t capacity = hs_capacity(set);
-
-    vector_t *values = vector_create(
-        .element_size = calc_aligned_size(header->value_size, ALIGNMENT),
-        .initial_cap = hs_count(set)
-    );
-    
-    if (!values) return NULL;
-
-    for (size_t slot = 0, value = 0; slot < capacity; ++slot)
-    {
-        if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, slot))
-        {
-            vector_set(values, value++, get_value(set, slot));
-        }
-    }
-
-    return values;
+    assert(first);
+    assert(second);
+    return (hs_view_t){.kind = HS_VIEW_DIFF, .first = first, .second = second};
 }
 
 
-/***                     ***
-* === static functions === *
-***                     ***/
-
-
-static size_t calc_usage_tbl_size(const size_t capacity)
+hs_view_t hs_view_symdiff(const hashset_t *const first, const hashset_t *const second)
 {
-    return calc_aligned_size(capacity * BIT_FIELD_LEN / BYTE, ALIGNMENT);
+    assert(first);
+    assert(second);
+    return (hs_view_t){.kind = HS_VIEW_SYMDIFF, .first = first, .second = second};
 }
 
 
-/*
-* Function gives an access to the hash set header that is allocated 
-* after vector's control struct.
-*/
-static hs_header_t *get_hs_header(const hashset_t *const set)
+const void *hs_view_next(hs_view_t *const view)
 {
-    return (hs_header_t*)vector_get_ext_header(set);
-}
+    assert(view);
 
+    const void *value = NULL;
 
-static char *get_value(const hashset_t *const set, const size_t index)
-{
-    return (char*)vector_get(set, index);
-}
-
+    switch (view->kind)
+    {
+        case HS_VIEW_UNION:
+            if (0 == view->stage)
+            {
+                if ((value = next_value(view->first, &view->slot))) return value;
+                view->stage = 1;
+                view->slot = 0;
+            }
+            return view_next_in(view, view->second, view->first, false);
+
+        case HS_VIEW_INTERSECTION:
+            return view_next_in(view, view->first, view->second, true);
+
+        case HS_VIEW_DIFF:
+            return view_next_in(view, view->first, view->second, false);
+
+        case HS_VIEW_SYMDIFF:
+            if (0 == view->stage)
+            {
+                if ((value = view_next_in(view, view->first, view->second, false))) return value;
+                view->stage = 1;
+                view->slot = 0;
+            }
+            return view_next_in(view, view->second, view->first, false);
+    }
 
-static void set_value(hashset_t *const set, const size_t index, const void *const value)
-{
-    const hs_header_t *header = get_hs_header(set);
-    char *entry = (char*) vector_get(set, index);
-    memcpy(entry, value, header->value_size);
+    return NULL;
 }
 
 
-/*
-* `a` and `b` factors used in conversion of the hash code into index.
-* randomization makes hash function less pridictable.
-*/
-static void randomize_factors(hs_header_t *const header)
+size_t hs_view_count(hs_view_t *const view)
 {
-    header->a = (rand() % (LARGE_PRIME-1)) + 1;  /* [1, p-1] */
-    header->b = (rand() % (LARGE_PRIME));        /* [0, p-1] */
+    assert(view);
+
+    size_t count = 0;
+    while (hs_view_next(view))
+    {
+        ++count;
+    }
+    return count;
 }
 
 
-/*
-* Calculates index utilizing multiplicative hashing. (a*h + b) mod p mod c
-*/
-static size_t hash_to_index(const hs_header_t *header, const hash_t hash, const size_t capacity)
+size_t hs_intersection_count(const hashset_t *const first, const hashset_t *const second)
 {
-    return ((header->a * hash + header->b) % LARGE_PRIME) % capacity;
+    hs_view_t view = hs_view_intersection(first, second);
+    return hs_view_count(&view);
 }
 
 
-static hs_status_t rehash(hashset_t **const set, const size_t new_cap)
+bool hs_is_subset(const hashset_t *const set, const hashset_t *const other)
 {
-    assert(new_cap >= hs_count(*set));
-
-    const hs_header_t *old_header = get_hs_header(*set);
-    const size_t prev_capacity = vector_initial_capacity(*set);
+    assert(set);
+    assert(other);
 
-    hashset_t *new = hs_create(.initial_cap = new_cap,
-        .value_size = old_header->value_size,
-        .hashfunc = old_header->hashfunc,
-    );
+    const size_t count = hs_count(set);
+    const size_t other_count = hs_count(other);
 
-    if (!new) return (hs_status_t)VECTOR_ALLOC_ERROR;
+    if (count > other_count) return false;
 
-    for (size_t i = 0; i < prev_capacity; ++i)
+    /* subset of the same size is an equal set,
+    *  digests are comparable only when computed by the same hashfunc */
+    if (count == other_count
+        && get_hs_header(set)->hashfunc == get_hs_header(other)->hashfunc
+        && hs_digest(set) != hs_digest(other))
     {
-        if (HS_SLOT_USED == bitset_test(old_header->usage_tbl, BIT_FIELD_LEN, i))
-        {
-            (void) hs_insert(&new, get_value(*set, i)); /* always succeedes */
-        }
+        return false;
     }
 
-    hs_destroy(*set);
-    *set = new;
-    return HS_SUCCESS;
+    hs_view_t view = hs_view_diff(set, other);
+    return NULL == hs_view_next(&view);
 }
 
 
-static bool contained_in(const void *const element, void *const param)
+bool hs_is_disjoint(const hashset_t *const first, const hashset_t *const second)
 {
-    const hashset_t *const other = param;
-    return hs_contains(other, element);
+    hs_view_t view = hs_view_intersection(first, second);
+    return NULL == hs_view_next(&view);
 }
 
 
-static bool not_contained_in(const void *const element, void *const param)
+bool hs_equal(const hashset_t *const first, const hashset_t *const second)
 {
-    return !contained_in(element, param);
+    assert(first);
+    assert(second);
+    assert(get_hs_header(first)->value_size == get_hs_header(second)->value_size);
+
+    if (first == second) return true;
+    if (hs_count(first) != hs_count(second)) return false;
+
+    return hs_is_subset(first, second);
 }
 
 
-static bool contained_in_both(const void *const element, void *const param)
+uint64_t hs_digest(const hashset_t *const set)
 {
-    struct two_sets *sets = param;
-    return hs_contains(sets->a, element) && hs_contains(sets->b, element);
+    assert(set);
+    return get_hs_header(set)->digest;
 }
 
+
+size_t hs_capacity(const hashset_t *const set)
+{
+    assert(set);
+
+    return vector_initial_capacity(set);
+}
+
+
+size_t hs_count(const hashset_t *const set)
+{
+    assert(set);
+    return get_hs_header(set)->count;
+}
+
+
+vector_t *hs_values(const hashset_t *const set)
+{
+    assert(set);
+
+    const hs_header_t *header = get_hs_header(set);
+    const size_t count = hs_count(set);
+
+    vector_t *values = vector_create(
+        .element_size = header->element_size,
+        .initial_cap = count
+    );
+    
+    if (!values) return NULL;
+
+    if (count) export_values(set, vector_get(values, 0), header->element_size, 1);
+
+    return values;
+}
+
+
+size_t hs_export_(const hashset_t *const set, void *const buffer, const hs_export_opts_t *const opts)
+{
+    assert(set);
+    assert(buffer || 0 == hs_count(set));
+    assert(opts);
+
+    const hs_header_t *header = get_hs_header(set);
+    const size_t count = export_values(set, buffer, header->value_size, opts->threads);
+
+    if (opts->compare)
+    {
+        qsort(buffer, count, header->value_size, opts->compare);
+    }
+
+    return count;
+}
+
+
+size_t hs_sorted_union(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out)
+{
+    assert((a || !a_len) && (b || !b_len));
+    assert(compare);
+    assert(out || !(a_len + b_len));
+
+    return merge(a, a_len, b, b_len, value_size, compare, out, MERGE_UNION);
+}
+
+
+size_t hs_sorted_intersection(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out)
+{
+    assert((a || !a_len) && (b || !b_len));
+    assert(compare);
+
+    /* probing the larger side beats the linear merge on skewed sizes */
+    if (a_len * GALLOP_RATIO < b_len)
+    {
+        return gallop_intersection(a, a_len, b, b_len, value_size, compare, out);
+    }
+    if (b_len * GALLOP_RATIO < a_len)
+    {
+        return gallop_intersection(b, b_len, a, a_len, value_size, compare, out);
+    }
+    return merge(a, a_len, b, b_len, value_size, compare, out, MERGE_INTERSECTION);
+}
+
+
+size_t hs_sorted_diff(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out)
+{
+    assert((a || !a_len) && (b || !b_len));
+    assert(compare);
+
+    return merge(a, a_len, b, b_len, value_size, compare, out, MERGE_DIFF);
+}
+
+
+size_t hs_sorted_symdiff(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out)
+{
+    assert((a || !a_len) && (b || !b_len));
+    assert(compare);
+
+    return merge(a, a_len, b, b_len, value_size, compare, out, MERGE_SYMDIFF);
+}
+
+
+hs_layout_t hs_layout(const hashset_t *const set)
+{
+    assert(set);
+
+    const hs_header_t *header = get_hs_header(set);
+    return (hs_layout_t){
+        .usage_tbl = header->usage_tbl,
+        .values = get_value(set, 0),
+        .capacity = hs_capacity(set),
+        .element_size = header->element_size,
+        .probing = header->probing,
+        .a = header->a,
+        .b = header->b,
+    };
+}
+
+
+bool hs_filter_test_hashed(const hashset_t *const set, const hash_t hash)
+{
+    assert(set);
+    return filter_test(set, hash);
+}
+
+
+size_t hs_memory_usage(const hashset_t *const set)
+{
+    assert(set);
+
+    const hs_header_t *header = get_hs_header(set);
+    const size_t capacity = hs_capacity(set);
+
+    return sizeof(hs_header_t)
+        + calc_usage_tbl_size(capacity)
+        + calc_aligned_size(header->filter_bits / BYTE, ALIGNMENT)
+        + capacity * header->element_size;
+}
+
+
+hs_status_t hs_analyze_hash(const void *const values, const size_t count,
+        const size_t value_size, const hashfunc_t hashfunc,
+        size_t capacity, hs_hash_report_t *const report)
+{
+    assert(values || 0 == count);
+    assert(value_size && hashfunc && report);
+
+    if (0 == capacity)
+    {
+        capacity = 1;
+        while (capacity < 2 * count)
+        {
+            capacity *= 2;
+        }
+    }
+    if (count >= capacity) return HS_INVALID_ARGUMENT;
+
+    hash_t *hashes = malloc(count * sizeof(hash_t));
+    size_t *home_counts = calloc(capacity, sizeof(size_t));
+    char *used = calloc(capacity, sizeof(char));
+    if (!hashes || !home_counts || !used)
+    {
+        free(hashes);
+        free(home_counts);
+        free(used);
+        return HS_ALLOC_ERROR;
+    }
+
+    /* throughput: repeat over the sample until the timing is meaningful */
+    const char *const bytes = values;
+    size_t calls = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            hashes[i] = hashfunc(bytes + i * value_size, value_size);
+        }
+        calls += count;
+    }
+    while (0 != count && elapsed_ns(&start) < BENCH_MIN_NS);
+    const double hash_time = elapsed_ns(&start);
+
+    unsigned int a, b;
+    randomize_factors(&a, &b);
+
+    /* place values the way `hs_insert` does */
+    size_t total_probes = 0;
+    size_t max_probes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t home = hs_hash_to_index(a, b, hashes[i], capacity);
+        ++home_counts[home];
+
+        size_t probes = 1;
+        size_t index = home;
+        while (used[index])
+        {
+            index = (index + 1) % capacity;
+            ++probes;
+        }
+        used[index] = 1;
+
+        total_probes += probes;
+        if (probes > max_probes) max_probes = probes;
+    }
+
+    const double expected = (double)count / capacity;
+    double chi_square = 0.0;
+    size_t empty_slots = 0;
+    size_t max_home_count = 0;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const double diff = home_counts[i] - expected;
+        chi_square += diff * diff;
+        if (0 == home_counts[i]) ++empty_slots;
+        if (home_counts[i] > max_home_count) max_home_count = home_counts[i];
+    }
+    chi_square = (0 == count) ? 0.0 : chi_square / expected;
+
+    /*
+    * Unsuccessful search from slot `i` stops at the first unused slot.
+    * Walking backwards from an unused slot yields every run length in one pass.
+    */
+    size_t empty = 0;
+    while (used[empty])
+    {
+        ++empty;
+    }
+    size_t total_miss_probes = 0;
+    size_t run = 0;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const size_t index = (empty + capacity - i) % capacity;
+        run = used[index] ? run + 1 : 0;
+        total_miss_probes += run + 1;
+    }
+
+    const double load = expected;
+    const double degrees = capacity - 1;
+    *report = (hs_hash_report_t){
+        .capacity = capacity,
+        .load_factor = load,
+        .empty_slots = empty_slots,
+        .max_home_count = max_home_count,
+        .chi_square = chi_square,
+        .chi_square_z = (0.0 == degrees) ? 0.0 : (chi_square - degrees) / sqrt(2.0 * degrees),
+        .expected_hit_probes = 0.5 * (1.0 + 1.0 / (1.0 - load)),
+        .observed_hit_probes = (0 == count) ? 1.0 : (double)total_probes / count,
+        .expected_miss_probes = 0.5 * (1.0 + 1.0 / ((1.0 - load) * (1.0 - load))),
+        .observed_miss_probes = (double)total_miss_probes / capacity,
+        .max_probes = max_probes,
+        .hash_ns = (0 == calls) ? 0.0 : hash_time / calls,
+    };
+
+    free(hashes);
+    free(home_counts);
+    free(used);
+    return HS_SUCCESS;
+}
+
+
+/***                     ***
+* === static functions === *
+***                     ***/
+
+
+static size_t calc_usage_tbl_size(const size_t capacity)
+{
+    return calc_aligned_size((capacity * BIT_FIELD_LEN + BYTE - 1) / BYTE, ALIGNMENT);
+}
+
+
+/*
+* Packed slots keep values at their natural size,
+* otherwise every slot is rounded up to the `ALIGNMENT`.
+*/
+static size_t calc_element_size(const size_t value_size, const bool packed)
+{
+    return packed ? value_size : calc_aligned_size(value_size, ALIGNMENT);
+}
+
+
+/*
+* Cuckoo tables consist of whole buckets, at least two of them.
+*/
+static size_t calc_cuckoo_capacity(const size_t capacity)
+{
+    const size_t buckets = (capacity + HS_BUCKET_SLOTS - 1) / HS_BUCKET_SLOTS;
+    return (buckets < 2 ? 2 : buckets) * HS_BUCKET_SLOTS;
+}
+
+
+/*
+* Optimal bloom filter size for `capacity` elements: m = -n * ln(p) / ln(2)^2,
+* rounded to whole bytes and limited by `max_bytes`.
+*/
+static size_t calc_filter_bits(const size_t capacity, const float fp_rate, const size_t max_bytes)
+{
+    if (fp_rate <= 0.0f || fp_rate >= 1.0f || 0 == capacity) return 0;
+
+    const double bits = -(double)capacity * log(fp_rate) / (LN2 * LN2);
+    size_t bytes = (size_t)ceil(bits / BYTE);
+
+    if (max_bytes && bytes > max_bytes)
+    {
+        bytes = max_bytes;
+    }
+    return bytes * BYTE;
+}
+
+
+/*
+* Optimal amount of hash functions: k = m / n * ln(2).
+*/
+static unsigned int calc_filter_hashes(const size_t capacity, const size_t filter_bits)
+{
+    if (0 == filter_bits) return 0;
+
+    const double k = round((double)filter_bits / capacity * LN2);
+    if (k < 1.0) return 1;
+    if (k > FILTER_MAX_HASHES) return FILTER_MAX_HASHES;
+    return (unsigned int)k;
+}
+
+
+/*
+* Function gives an access to the hash set header that is allocated 
+* after vector's control struct.
+*/
+static hs_header_t *get_hs_header(const hashset_t *const set)
+{
+    return (hs_header_t*)vector_get_ext_header(set);
+}
+
+
+/*
+* Reconstructs creation options from the set header.
+*/
+static hs_opts_t get_opts(const hashset_t *const set)
+{
+    const hs_header_t *header = get_hs_header(set);
+    return (hs_opts_t){
+        .value_size = header->value_size,
+        .initial_cap = hs_capacity(set),
+        .hashfunc = header->hashfunc,
+        .probing = header->probing,
+        .packed = header->element_size == header->value_size,
+        .min_load_factor = header->min_load_factor,
+        .huge_pages = header->huge_pages,
+        .numa_policy = header->numa_policy,
+        .numa_node = header->numa_node,
+        .filter_fp_rate = header->filter_fp_rate,
+        .filter_max_bytes = header->filter_max_bytes,
+        .background_resize = header->background,
+    };
+}
+
+
+/*
+* Bloom filter bits are stored right after the usage table.
+*/
+static char *get_filter(const hashset_t *const set)
+{
+    const hs_header_t *header = get_hs_header(set);
+    return (char*)header->usage_tbl + calc_usage_tbl_size(hs_capacity(set));
+}
+
+
+/*
+* Spreads element hash over 64 bits (splitmix64 finalizer).
+* Used for bloom filter positions and the set digest.
+*/
+static uint64_t mix_hash(const hash_t hash)
+{
+    uint64_t x = (uint64_t)hash + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+
+static void filter_add(hashset_t *const set, const hash_t hash)
+{
+    const hs_header_t *header = get_hs_header(set);
+    if (0 == header->filter_bits) return;
+
+    /* filter positions are generated as h1 + i * h2 (double hashing) */
+    char *filter = get_filter(set);
+    const uint64_t mixed = mix_hash(hash);
+    const uint64_t h1 = mixed & 0xffffffffu;
+    const uint64_t h2 = (mixed >> 32) | 1u;
+
+    for (unsigned int i = 0; i < header->filter_hashes; ++i)
+    {
+        const size_t bit = (h1 + i * h2) % header->filter_bits;
+        filter[bit / BYTE] |= (char)(1u << (bit % BYTE));
+    }
+}
+
+
+/*
+* Returns false only if the value with such hash was never inserted
+* since last rehash. Always true when filter is disabled.
+*/
+static bool filter_test(const hashset_t *const set, const hash_t hash)
+{
+    const hs_header_t *header = get_hs_header(set);
+    if (0 == header->filter_bits) return true;
+
+    const char *filter = get_filter(set);
+    const uint64_t mixed = mix_hash(hash);
+    const uint64_t h1 = mixed & 0xffffffffu;
+    const uint64_t h2 = (mixed >> 32) | 1u;
+
+    for (unsigned int i = 0; i < header->filter_hashes; ++i)
+    {
+        const size_t bit = (h1 + i * h2) % header->filter_bits;
+        if (!(filter[bit / BYTE] & (1u << (bit % BYTE)))) return false;
+    }
+    return true;
+}
+
+
+static char *get_value(const hashset_t *const set, const size_t index)
+{
+    return (char*)vector_get(set, index);
+}
+
+
+static void set_value(hashset_t *const set, const size_t index, const void *const value)
+{
+    const hs_header_t *header = get_hs_header(set);
+    char *entry = (char*) vector_get(set, index);
+    memcpy(entry, value, header->value_size);
+}
+
+
+/*
+* Applies requested placement to the page aligned part of the value array.
+* Both hints are best effort, when they are unsupported by the system
+* or rejected by the kernel the table stays on regular pages.
+*/
+static void place_table(const hashset_t *const set)
+{
+    const hs_header_t *header = get_hs_header(set);
+    const size_t table_size = hs_capacity(set) * header->element_size;
+
+    if (!header->huge_pages && HS_NUMA_DEFAULT == header->numa_policy) return;
+    if (table_size < HUGE_PAGE_SIZE) return; /* not worth it for small tables */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MADVISE)
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t start = ((uintptr_t)get_value(set, 0) + page - 1) & ~(page - 1);
+    const uintptr_t end = ((uintptr_t)get_value(set, 0) + table_size) & ~(page - 1);
+
+    if (end <= start) return;
+
+#if defined(MADV_HUGEPAGE)
+    if (header->huge_pages)
+    {
+        (void) madvise((void*)start, end - start, MADV_HUGEPAGE);
+    }
+#endif
+
+#if defined(HAVE_SYS_SYSCALL_H) && defined(HAVE_LINUX_MEMPOLICY_H) && defined(SYS_mbind)
+    unsigned long nodemask = 0;
+    int mode = MPOL_DEFAULT;
+
+    switch (header->numa_policy)
+    {
+        case HS_NUMA_DEFAULT: return;
+        case HS_NUMA_INTERLEAVE:
+            mode = MPOL_INTERLEAVE;
+            nodemask = ~0ul; /* kernel narrows it to the allowed nodes */
+            break;
+        case HS_NUMA_BIND:
+            if (header->numa_node < 0 || header->numa_node >= (int)(sizeof(nodemask) * BYTE)) return;
+            mode = MPOL_BIND;
+            nodemask = 1ul << header->numa_node;
+            break;
+    }
+
+    (void) syscall(SYS_mbind, (void*)start, end - start, mode,
+        &nodemask, sizeof(nodemask) * BYTE, MPOL_MF_MOVE);
+#endif
+#endif
+}
+
+
+/*
+* `a` and `b` factors used in conversion of the hash code into index.
+* randomization makes hash function less pridictable.
+*/
+static void randomize_factors(unsigned int *const a, unsigned int *const b)
+{
+    *a = (rand() % (HS_LARGE_PRIME-1)) + 1;  /* [1, p-1] */
+    *b = (rand() % (HS_LARGE_PRIME));        /* [0, p-1] */
+}
+
+
+static double elapsed_ns(const struct timespec *const since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1e9 + (now.tv_nsec - since->tv_nsec);
+}
+
+
+/*
+* Calls user hashfunc. Values may come unaligned from the storage of a packed set,
+* not necessarily the one being probed, so those are handed through an aligned buffer.
+*/
+static hash_t hash_value(const hs_header_t *const header, const void *const value)
+{
+    if (0 == (uintptr_t)value % ALIGNMENT)
+    {
+        return header->hashfunc(value, header->value_size);
+    }
+
+    max_align_t aligned[(header->value_size + sizeof(max_align_t) - 1) / sizeof(max_align_t)];
+    memcpy(aligned, value, header->value_size);
+    return header->hashfunc(aligned, header->value_size);
+}
+
+
+/*
+* Returns slot of the value or `capacity` when it is absent.
+*/
+static size_t find_slot(const hashset_t *const set, const void *const value, const hash_t hash)
+{
+    const hs_header_t *header = get_hs_header(set);
+    const size_t capacity = hs_capacity(set);
+
+    if (HS_PROBING_CUCKOO == header->probing)
+    {
+        size_t buckets[2];
+        cuckoo_buckets(header, hash, capacity, buckets);
+
+        for (size_t b = 0; b < 2; ++b)
+        {
+            for (size_t s = 0; s < HS_BUCKET_SLOTS; ++s)
+            {
+                const size_t index = buckets[b] * HS_BUCKET_SLOTS + s;
+                if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, index)
+                    && 0 == memcmp(get_value(set, index), value, header->value_size))
+                {
+                    return index;
+                }
+            }
+        }
+        return capacity;
+    }
+
+    const size_t start_index = hash_to_index(header, hash, capacity);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const size_t index = (i + start_index) % capacity;
+        const hs_slot_status_t slot_stat = bitset_test(header->usage_tbl, BIT_FIELD_LEN, index);
+        switch (slot_stat)
+        {
+            case HS_SLOT_UNUSED: return capacity;
+
+            case HS_SLOT_USED:
+                if (0 == memcmp(get_value(set, index), value, header->value_size))
+                {
+                    return index;
+                }
+                break;
+
+            case HS_SLOT_DELETED: continue;
+        }
+    }
+
+    return capacity;
+}
+
+
+/*
+* Inserts value into the table, growing it synchronously when full.
+*/
+static hs_status_t insert_value(hashset_t **const set, const void *const value, const hash_t hash)
+{
+    const hs_header_t *header = get_hs_header(*set);
+    if (HS_PROBING_CUCKOO == header->probing) return cuckoo_insert(set, value, hash);
+
+    const size_t capacity = hs_capacity(*set);
+    const size_t start_index = hash_to_index(header, hash, capacity);
+    size_t vacant = capacity; /* first reusable slot in the probe sequence */
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const size_t index = (i + start_index) % capacity;
+        const hs_slot_status_t slot_stat = bitset_test(header->usage_tbl, BIT_FIELD_LEN, index);
+        if (HS_SLOT_UNUSED == slot_stat)
+        {
+            if (vacant == capacity) vacant = index;
+            break;
+        }
+        else if (HS_SLOT_DELETED == slot_stat)
+        {
+            /* value may still be present further in the sequence */
+            if (vacant == capacity) vacant = index;
+        }
+        else if (0 == memcmp(value, get_value(*set, index), header->value_size))
+        {
+            return HS_ALREADY_EXISTS;
+        }
+    }
+
+    if (vacant != capacity)
+    {
+        return occupy_slot(set, vacant, value, hash);
+    }
+
+    /* table is full, the only moment background resize blocks */
+    if (atomic_load_explicit(&header->migration, memory_order_relaxed))
+    {
+        const hashset_t *const full = *set;
+        finish_migration(set, true);
+        if (*set != full) return insert_value(set, value, hash);
+    }
+
+    hs_status_t status = rehash(set, 2 * capacity);
+    if (HS_SUCCESS != status) return status;
+
+    return insert_value(set, value, hash);
+}
+
+
+/*
+* Stores new value in the given slot and updates set bookkeeping.
+*/
+static hs_status_t occupy_slot(hashset_t **const set, const size_t index,
+        const void *const value, const hash_t hash)
+{
+    if (HS_SUCCESS != make_unique(set)) return HS_ALLOC_ERROR;
+
+    hs_header_t *header = get_hs_header(*set);
+    migration_t *const migration = atomic_load_explicit(&header->migration, memory_order_relaxed);
+    if (migration) pthread_mutex_lock(&migration->lock);
+
+    if (HS_SLOT_DELETED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, index)) --header->deleted;
+    bitset_set(header->usage_tbl, BIT_FIELD_LEN, index, HS_SLOT_USED);
+    set_value(*set, index, value);
+    ++header->count;
+    header->digest += mix_hash(hash);
+    filter_add(*set, hash);
+
+    if (migration)
+    {
+        /* slot was already copied, the copy has to catch up */
+        if (index < migration->cursor
+            && HS_ALLOC_ERROR == insert_value(&migration->target, value, hash))
+        {
+            migration->failed = true;
+        }
+        pthread_mutex_unlock(&migration->lock);
+    }
+
+    return HS_SUCCESS;
+}
+
+
+/*
+* Frees the slot and updates set bookkeeping, the table must be unique.
+*/
+static void release_slot(hashset_t *const set, const size_t index, const hash_t hash)
+{
+    hs_header_t *header = get_hs_header(set);
+    migration_t *const migration = atomic_load_explicit(&header->migration, memory_order_relaxed);
+    if (migration) pthread_mutex_lock(&migration->lock);
+
+    /* cuckoo lookups never walk past a slot, so no tombstones needed */
+    if (HS_PROBING_CUCKOO == header->probing)
+    {
+        bitset_set(header->usage_tbl, BIT_FIELD_LEN, index, HS_SLOT_UNUSED);
+    }
+    else
+    {
+        bitset_set(header->usage_tbl, BIT_FIELD_LEN, index, HS_SLOT_DELETED);
+        ++header->deleted;
+    }
+    --header->count;
+    header->digest -= mix_hash(hash);
+
+    if (migration)
+    {
+        if (index < migration->cursor)
+        {
+            const void *const value = get_value(set, index);
+            const size_t copied = find_slot(migration->target, value, hash);
+            if (hs_capacity(migration->target) != copied)
+            {
+                release_slot(migration->target, copied, hash);
+            }
+        }
+        pthread_mutex_unlock(&migration->lock);
+    }
+}
+
+
+static void cuckoo_buckets(const hs_header_t *const header, const hash_t hash,
+        const size_t capacity, size_t buckets[2])
+{
+    const size_t amount = capacity / HS_BUCKET_SLOTS;
+    buckets[0] = hs_hash_to_index(header->a, header->b, hash, amount);
+    buckets[1] = hs_cuckoo_alt_bucket(buckets[0], hash, amount);
+}
+
+
+/*
+* Returns unused slot of the bucket or `capacity` if bucket is full.
+*/
+static size_t cuckoo_free_slot(const hs_header_t *const header, const size_t bucket, const size_t capacity)
+{
+    for (size_t s = 0; s < HS_BUCKET_SLOTS; ++s)
+    {
+        const size_t index = bucket * HS_BUCKET_SLOTS + s;
+        if (HS_SLOT_USED != bitset_test(header->usage_tbl, BIT_FIELD_LEN, index)) return index;
+    }
+    return capacity;
+}
+
+
+/*
+* Grows the table once when the value can't be placed. If it still doesn't fit,
+* too many values share its buckets and further growth won't help,
+* the set is left untouched then.
+*/
+static hs_status_t cuckoo_insert(hashset_t **const set, const void *const value, const hash_t hash)
+{
+    hs_status_t status = cuckoo_place(set, value, hash);
+    if (HS_COLLISION_ERROR != status) return status;
+
+    hashset_t *grown;
+    status = rebuild(*set, 2 * hs_capacity(*set), &grown);
+    if (HS_SUCCESS != status) return status;
+
+    status = cuckoo_place(&grown, value, hash);
+    if (HS_SUCCESS != status)
+    {
+        hs_destroy(grown);
+        return status;
+    }
+
+    hs_destroy(*set);
+    *set = grown;
+    return HS_SUCCESS;
+}
+
+
+/*
+* Places value into one of its two buckets. When both are full, displacement
+* path (each victim moves to its alternative bucket) is searched breadth-first
+* without touching the table, then applied starting from the free slot.
+* Fails with `HS_COLLISION_ERROR` if no path is found within `CUCKOO_MAX_NODES`
+* visited buckets.
+*/
+static hs_status_t cuckoo_place(hashset_t **const set, const void *const value, const hash_t hash)
+{
+    const hs_header_t *header = get_hs_header(*set);
+    const size_t capacity = hs_capacity(*set);
+
+    if (capacity != find_slot(*set, value, hash)) return HS_ALREADY_EXISTS;
+
+    size_t buckets[2];
+    cuckoo_buckets(header, hash, capacity, buckets);
+
+    size_t free_slot = cuckoo_free_slot(header, buckets[0], capacity);
+    if (capacity == free_slot) free_slot = cuckoo_free_slot(header, buckets[1], capacity);
+    if (capacity != free_slot) return occupy_slot(set, free_slot, value, hash);
+
+    cuckoo_node_t queue[CUCKOO_MAX_NODES] = {
+        {.bucket = buckets[0], .victim = capacity},
+        {.bucket = buckets[1], .victim = capacity},
+    };
+    size_t tail = 2;
+
+    for (size_t head = 0; head < tail; ++head)
+    {
+        for (size_t s = 0; s < HS_BUCKET_SLOTS; ++s)
+        {
+            const size_t victim = queue[head].bucket * HS_BUCKET_SLOTS + s;
+
+            size_t victim_buckets[2];
+            cuckoo_buckets(header, hash_value(header, get_value(*set, victim)), capacity, victim_buckets);
+            const size_t alt = (victim_buckets[0] == queue[head].bucket)
+                ? victim_buckets[1]
+                : victim_buckets[0];
+
+            /* slots of the path must be distinct */
+            bool on_path = false;
+            for (size_t n = head; !on_path && capacity != n; n = queue[n].parent)
+            {
+                on_path = (queue[n].bucket == alt);
+                if (capacity == queue[n].victim) break;
+            }
+            if (on_path) continue;
+
+            free_slot = cuckoo_free_slot(header, alt, capacity);
+            if (capacity != free_slot)
+            {
+                if (HS_SUCCESS != make_unique(set)) return HS_ALLOC_ERROR;
+
+                hs_header_t *unique_header = get_hs_header(*set);
+                size_t from = victim;
+                size_t node = head;
+
+                /* shift values along the path towards the free slot */
+                while (true)
+                {
+                    set_value(*set, free_slot, get_value(*set, from));
+                    bitset_set(unique_header->usage_tbl, BIT_FIELD_LEN, free_slot, HS_SLOT_USED);
+                    free_slot = from;
+
+                    if (capacity == queue[node].victim) break;
+                    from = queue[node].victim;
+                    node = queue[node].parent;
+                }
+                return occupy_slot(set, free_slot, value, hash);
+            }
+
+            if (tail < CUCKOO_MAX_NODES)
+            {
+                queue[tail++] = (cuckoo_node_t){.bucket = alt, .victim = victim, .parent = head};
+            }
+        }
+    }
+
+    return HS_COLLISION_ERROR;
+}
+
+
+/*
+* Calculates index utilizing multiplicative hashing. (a*h + b) mod p mod c
+*/
+static size_t hash_to_index(const hs_header_t *header, const hash_t hash, const size_t capacity)
+{
+    return hs_hash_to_index(header->a, header->b, hash, capacity);
+}
+
+
+/*
+* Capacity that fits `count` elements without rehashing.
+*/
+static size_t reserve_capacity(const hashset_t *const set, size_t count)
+{
+    /* cuckoo tables can't be filled up completely, leave some slack */
+    if (HS_PROBING_CUCKOO == get_hs_header(set)->probing)
+    {
+        count += count / CUCKOO_SLACK;
+    }
+
+    size_t new_cap = hs_capacity(set);
+    if (count <= new_cap) return new_cap;
+
+    /* keep growing by the factor of 2 as `hs_insert` does */
+    if (0 == new_cap) new_cap = count;
+    while (new_cap < count)
+    {
+        new_cap *= 2;
+    }
+
+    return new_cap;
+}
+
+
+/*
+* Prepares bulk insertion of `missing` new values, so the set either
+* receives every value or keeps just its own elements. Room is reserved
+* in the set itself, reserved linear inserts can't fail then. Cuckoo placement
+* may fail even with room reserved, so inserted values are logged to be
+* removed again, values displaced meanwhile stay valid where they are.
+*/
+static hs_status_t begin_bulk_insert(hashset_t **const set, const size_t missing, bulk_log_t *const log)
+{
+    *log = (bulk_log_t){ .values = NULL, .count = 0 };
+
+    hs_status_t status = hs_reserve(set, hs_count(*set) + missing);
+    if (HS_SUCCESS != status) return status;
+
+    /* shared table is copied now rather than on the first insert */
+    status = make_unique(set);
+    if (HS_SUCCESS != status) return status;
+
+    if (HS_PROBING_CUCKOO == get_hs_header(*set)->probing)
+    {
+        log->values = malloc(missing * sizeof(*log->values));
+        if (!log->values) return HS_ALLOC_ERROR;
+    }
+
+    return HS_SUCCESS;
+}
+
+
+/*
+* Inserts one value of bulk insertion, values already contained are skipped.
+*/
+static hs_status_t bulk_insert(hashset_t **const set, const void *const value, bulk_log_t *const log)
+{
+    const hs_status_t status = hs_insert(set, value);
+    if (HS_ALREADY_EXISTS == status) return HS_SUCCESS;
+
+    if (HS_SUCCESS == status && log->values) log->values[log->count++] = value;
+    return status;
+}
+
+
+/*
+* Completes bulk insertion, `status` tells whether every value was inserted.
+* The set keeps reserved capacity when logged values are taken back.
+*/
+static hs_status_t end_bulk_insert(hashset_t **const set, bulk_log_t *const log, const hs_status_t status)
+{
+    if (HS_SUCCESS != status)
+    {
+        const hs_header_t *header = get_hs_header(*set);
+        for (size_t i = 0; i < log->count; ++i)
+        {
+            const hash_t hash = hash_value(header, log->values[i]);
+            release_slot(*set, find_slot(*set, log->values[i], hash), hash);
+        }
+    }
+
+    free(log->values);
+    return status;
+}
+
+
+/*
+* Copies elements into a new table of `new_cap` slots, `set` is not modified.
+*/
+static hs_status_t rebuild(const hashset_t *const set, const size_t new_cap, hashset_t **const out)
+{
+    assert(new_cap >= hs_count(set));
+
+    const hs_header_t *old_header = get_hs_header(set);
+    const size_t prev_capacity = vector_initial_capacity(set);
+
+    hashset_t *new = create_like(set, new_cap);
+
+    if (!new) return (hs_status_t)VECTOR_ALLOC_ERROR;
+
+    for (size_t i = 0; i < prev_capacity; ++i)
+    {
+        if (HS_SLOT_USED == bitset_test(old_header->usage_tbl, BIT_FIELD_LEN, i))
+        {
+            /* cuckoo placement into the new table may still fail */
+            const void *const value = get_value(set, i);
+            const hs_status_t status = insert_value(&new, value, hash_value(old_header, value));
+            if (HS_SUCCESS != status)
+            {
+                hs_destroy(new);
+                return status;
+            }
+        }
+    }
+
+    *out = new;
+    return HS_SUCCESS;
+}
+
+
+static hs_status_t rehash(hashset_t **const set, const size_t new_cap)
+{
+    cancel_migration(*set);
+
+    hashset_t *new;
+    const hs_status_t status = rebuild(*set, new_cap, &new);
+    if (HS_SUCCESS != status) return status;
+
+    hs_destroy(*set);
+    *set = new;
+    return HS_SUCCESS;
+}
+
+
+/*
+* Copies used values into contiguous `dst` with given stride.
+* Table is split into chunks, used slots are counted per chunk,
+* prefix sum of the counts gives each chunk its output position,
+* then chunks are copied independently.
+*/
+static size_t export_values(const hashset_t *const set, void *const dst,
+        const size_t stride, size_t threads)
+{
+    const size_t capacity = hs_capacity(set);
+
+    if (threads > capacity / EXPORT_MIN_CHUNK) threads = capacity / EXPORT_MIN_CHUNK;
+    if (threads > EXPORT_MAX_THREADS) threads = EXPORT_MAX_THREADS;
+    if (threads < 1) threads = 1;
+
+    export_chunk_t chunks[EXPORT_MAX_THREADS];
+
+    for (size_t t = 0; t < threads; ++t)
+    {
+        chunks[t] = (export_chunk_t){
+            .set = set,
+            .dst = dst,
+            .stride = stride,
+            .begin = capacity * t / threads,
+            .end = capacity * (t + 1) / threads,
+        };
+    }
+
+    /* with single chunk the count is known already */
+    if (threads > 1) run_chunks(chunks, threads, export_count);
+    else chunks[0].count = hs_count(set);
+
+    size_t offset = 0;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        chunks[t].offset = offset;
+        offset += chunks[t].count;
+    }
+
+    run_chunks(chunks, threads, export_copy);
+    return offset;
+}
+
+
+static void *export_count(void *const param)
+{
+    export_chunk_t *chunk = param;
+    const hs_header_t *header = get_hs_header(chunk->set);
+
+    for (size_t i = chunk->begin; i < chunk->end; ++i)
+    {
+        if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, i))
+        {
+            ++chunk->count;
+        }
+    }
+    return NULL;
+}
+
+
+static void *export_copy(void *const param)
+{
+    export_chunk_t *chunk = param;
+    const hs_header_t *header = get_hs_header(chunk->set);
+    char *out = chunk->dst + chunk->offset * chunk->stride;
+
+    for (size_t i = chunk->begin; i < chunk->end; ++i)
+    {
+        if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, i))
+        {
+            memcpy(out, get_value(chunk->set, i), header->value_size);
+            out += chunk->stride;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+* Runs `job` for every chunk, first chunk is processed by the calling thread.
+* When a thread can't be started its chunk is processed inline as well.
+*/
+static void run_chunks(export_chunk_t *const chunks, const size_t amount, void *(*job)(void*))
+{
+    pthread_t workers[EXPORT_MAX_THREADS];
+    bool started[EXPORT_MAX_THREADS] = {0};
+
+    for (size_t t = 1; t < amount; ++t)
+    {
+        started[t] = (0 == pthread_create(&workers[t], NULL, job, &chunks[t]));
+    }
+
+    job(&chunks[0]);
+
+    for (size_t t = 1; t < amount; ++t)
+    {
+        if (started[t]) pthread_join(workers[t], NULL);
+        else job(&chunks[t]);
+    }
+}
+
+
+/*
+* Single pass over both sorted arrays, `op` selects which values are emitted:
+* taken only from `a`, only from `b` or from both.
+*/
+static size_t merge(const char *a, const size_t a_len, const char *b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, char *out, const merge_op_t op)
+{
+    const bool emit_a = (MERGE_INTERSECTION != op);
+    const bool emit_b = (MERGE_UNION == op || MERGE_SYMDIFF == op);
+    const bool emit_both = (MERGE_UNION == op || MERGE_INTERSECTION == op);
+
+    const char *const a_end = a + a_len * value_size;
+    const char *const b_end = b + b_len * value_size;
+    const char *const out_begin = out;
+
+    while (a < a_end && b < b_end)
+    {
+        const int order = compare(a, b);
+        if (order < 0)
+        {
+            if (emit_a) { memcpy(out, a, value_size); out += value_size; }
+            a += value_size;
+        }
+        else if (order > 0)
+        {
+            if (emit_b) { memcpy(out, b, value_size); out += value_size; }
+            b += value_size;
+        }
+        else
+        {
+            if (emit_both) { memcpy(out, a, value_size); out += value_size; }
+            a += value_size;
+            b += value_size;
+        }
+    }
+
+    /* tails have no counterpart in the other array */
+    if (emit_a && a < a_end)
+    {
+        memcpy(out, a, a_end - a);
+        out += a_end - a;
+    }
+    if (emit_b && b < b_end)
+    {
+        memcpy(out, b, b_end - b);
+        out += b_end - b;
+    }
+
+    return (out - out_begin) / value_size;
+}
+
+
+/*
+* Intersection of a small array with a much larger one: every value of `small`
+* is located in `large` by exponential search from the previous match position.
+*/
+static size_t gallop_intersection(const char *small, const size_t small_len,
+        const char *large, const size_t large_len,
+        const size_t value_size, const hs_compare_t compare, char *out)
+{
+    size_t written = 0;
+    size_t lo = 0;
+
+    for (size_t i = 0; i < small_len && lo < large_len; ++i)
+    {
+        const char *value = small + i * value_size;
+
+        /* find range (lo, hi] that may contain the value */
+        size_t step = 1;
+        size_t hi = lo;
+        while (hi < large_len && compare(large + hi * value_size, value) < 0)
+        {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi >= large_len) hi = large_len - 1;
+
+        /* binary search in [lo, hi] for the first element not less than value */
+        size_t l = lo, r = hi + 1;
+        while (l < r)
+        {
+            const size_t mid = l + (r - l) / 2;
+            if (compare(large + mid * value_size, value) < 0) l = mid + 1;
+            else r = mid;
+        }
+
+        lo = l;
+        if (lo < large_len && 0 == compare(large + lo * value_size, value))
+        {
+            memcpy(out + written * value_size, value, value_size);
+            ++written;
+            ++lo;
+        }
+    }
+
+    return written;
+}
+
+
+/*
+* Returns next used value starting from `*slot` and advances it past that value.
+*/
+static const void *next_value(const hashset_t *const set, size_t *const slot)
+{
+    const hs_header_t *header = get_hs_header(set);
+    const size_t capacity = hs_capacity(set);
+
+    for (; *slot < capacity; ++*slot)
+    {
+        if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, *slot))
+        {
+            return get_value(set, (*slot)++);
+        }
+    }
+    return NULL;
+}
+
+
+/*
+* Walks `walk` set and yields values whose membership in `probe` equals `want`.
+*/
+static const void *view_next_in(hs_view_t *const view, const hashset_t *const walk,
+        const hashset_t *const probe, const bool want)
+{
+    const void *value;
+    while ((value = next_value(walk, &view->slot)))
+    {
+        if (want == hs_contains(probe, value)) return value;
+    }
+    return NULL;
+}
+
+
+/*
+* Creates empty set with the same parameters as `proto`.
+*/
+static hashset_t *create_like(const hashset_t *const proto, const size_t capacity)
+{
+    hs_opts_t opts = get_opts(proto);
+    opts.initial_cap = capacity;
+
+    hashset_t *set = hs_create_(&opts);
+    if (!set) return NULL;
+
+    get_hs_header(set)->min_cap = get_hs_header(proto)->min_cap;
+    return set;
+}
+
+
+/*
+* Materializes view into a new set, only elements of the result are copied.
+*/
+static hashset_t *make_from_view(const hashset_t *const proto, hs_view_t view)
+{
+    hashset_t *result = create_like(proto, hs_capacity(proto));
+    if (!result) return NULL;
+
+    const void *value;
+    while ((value = hs_view_next(&view)))
+    {
+        if (HS_SUCCESS != hs_insert(&result, value))
+        {
+            hs_destroy(result);
+            return NULL;
+        }
+    }
+
+    return result;
+}
+
+
+/*
+* Gives `*set` handle its own copy of the table before modification,
+* when the table is shared with clones.
+*/
+static hs_status_t make_unique(hashset_t **const set)
+{
+    hs_header_t *header = get_hs_header(*set);
+    if (1 == atomic_load_explicit(&header->refs, memory_order_acquire)) return HS_SUCCESS;
+
+    hashset_t *copy = vector_clone(*set);
+    if (!copy) return HS_ALLOC_ERROR;
+
+    atomic_store_explicit(&get_hs_header(copy)->refs, 1, memory_order_relaxed);
+    atomic_init(&get_hs_header(copy)->migration, NULL);
+    place_table(copy);
+
+    /* ongoing background resize follows the modified handle,
+    *  the copy has the same content as the shared table */
+    migration_t *const migration = atomic_exchange_explicit(&header->migration, NULL, memory_order_acq_rel);
+    if (migration)
+    {
+        pthread_mutex_lock(&migration->lock);
+        migration->source = copy;
+        pthread_mutex_unlock(&migration->lock);
+        atomic_store_explicit(&get_hs_header(copy)->migration, migration, memory_order_relaxed);
+    }
+
+    hs_destroy(*set); /* drops this handle's reference */
+    *set = copy;
+    return HS_SUCCESS;
+}
+
+
+/*
+* Capacity the table shrinks to once load drops below `min_load_factor`.
+* Capacity is halved while the resulting load stays under twice the threshold
+* (but no more than a half), so the set doesn't thrash between grow and shrink.
+*/
+static size_t shrink_target(const hashset_t *const set)
+{
+    const hs_header_t *header = get_hs_header(set);
+    const size_t capacity = hs_capacity(set);
+
+    if (header->min_load_factor <= 0.0f
+        || capacity <= header->min_cap
+        || header->count >= capacity * header->min_load_factor)
+    {
+        return capacity;
+    }
+
+    const float target = header->min_load_factor < 0.25f
+        ? 2.0f * header->min_load_factor
+        : 0.5f;
+
+    size_t new_cap = capacity;
+    while (new_cap / 2 >= header->min_cap
+        && header->count <= (new_cap / 2) * target)
+    {
+        new_cap /= 2;
+    }
+
+    return new_cap;
+}
+
+
+/*
+* Shrinks sparse table, or purges tombstones when they take a quarter
+* of a background resized table. Allocation failure is not an error here,
+* the set just stays larger.
+*/
+static void shrink_if_sparse(hashset_t **const set)
+{
+    const hs_header_t *header = get_hs_header(*set);
+    const size_t capacity = hs_capacity(*set);
+    const size_t new_cap = shrink_target(*set);
+
+    if (header->background)
+    {
+        if (new_cap != capacity || 4 * header->deleted > capacity)
+        {
+            schedule_resize(set, new_cap);
+        }
+    }
+    else if (new_cap != capacity)
+    {
+        (void) rehash(set, new_cap);
+    }
+}
+
+
+/*
+* Starts copying the table into one of `new_cap` slots on a helper thread.
+* Does nothing when a copy is already in progress or can't be started,
+* the table is then resized synchronously once full.
+*/
+static void schedule_resize(hashset_t **const set, const size_t new_cap)
+{
+    hs_header_t *header = get_hs_header(*set);
+    if (!header->background || atomic_load_explicit(&header->migration, memory_order_relaxed)
+        || 1 != atomic_load_explicit(&header->refs, memory_order_acquire))
+    {
+        return;
+    }
+
+    migration_t *migration = malloc(sizeof(migration_t));
+    if (!migration) return;
+
+    *migration = (migration_t){
+        .source = *set,
+        .target = create_like(*set, new_cap),
+    };
+    atomic_init(&migration->cancel, false);
+    atomic_init(&migration->done, false);
+
+    if (!migration->target
+        || 0 != pthread_mutex_init(&migration->lock, NULL))
+    {
+        if (migration->target) hs_destroy(migration->target);
+        free(migration);
+        return;
+    }
+
+    if (0 != pthread_create(&migration->thread, NULL, migrate, migration))
+    {
+        pthread_mutex_destroy(&migration->lock);
+        hs_destroy(migration->target);
+        free(migration);
+        return;
+    }
+
+    atomic_store_explicit(&header->migration, migration, memory_order_release);
+}
+
+
+/*
+* Resize thread, copies source slots in batches.
+*/
+static void *migrate(void *const param)
+{
+    migration_t *const migration = param;
+
+    bool failed = false;
+    bool copied = false;
+    while (!failed && !copied
+        && !atomic_load_explicit(&migration->cancel, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&migration->lock);
+
+        /* source may have been handed over to another handle since last batch */
+        const hs_header_t *const header = get_hs_header(migration->source);
+        const size_t capacity = hs_capacity(migration->source);
+        const size_t end = migration->cursor + MIGRATE_BATCH < capacity
+            ? migration->cursor + MIGRATE_BATCH
+            : capacity;
+
+        for (size_t i = migration->cursor; i < end && !migration->failed; ++i)
+        {
+            if (HS_SLOT_USED == bitset_test(header->usage_tbl, BIT_FIELD_LEN, i))
+            {
+                const void *const value = get_value(migration->source, i);
+                if (HS_ALLOC_ERROR == insert_value(&migration->target, value, hash_value(header, value)))
+                {
+                    migration->failed = true;
+                }
+            }
+        }
+        migration->cursor = end;
+        failed = migration->failed;
+        copied = (end == capacity);
+
+        pthread_mutex_unlock(&migration->lock);
+    }
+
+    atomic_store_explicit(&migration->done, true, memory_order_release);
+    return NULL;
+}
+
+
+/*
+* Replaces the table with its background copy once the copy is complete
+* (or when `wait` is set, waits for it). Failed copy is discarded.
+*/
+static void finish_migration(hashset_t **const set, const bool wait)
+{
+    hs_header_t *header = get_hs_header(*set);
+    if (!atomic_load_explicit(&header->migration, memory_order_relaxed)) return;
+
+    /* claimed first, another handle of a shared table may be finishing it */
+    migration_t *const migration = atomic_exchange_explicit(&header->migration, NULL, memory_order_acq_rel);
+    if (!migration) return;
+    if (!wait && !atomic_load_explicit(&migration->done, memory_order_acquire))
+    {
+        atomic_store_explicit(&header->migration, migration, memory_order_release);
+        return;
+    }
+
+    pthread_join(migration->thread, NULL);
+    pthread_mutex_destroy(&migration->lock);
+
+    if (migration->failed)
+    {
+        hs_destroy(migration->target);
+    }
+    else
+    {
+        hs_destroy(*set);
+        *set = migration->target;
+    }
+
+    free(migration);
+}
+
+
+/*
+* Stops background resize and drops its copy.
+*/
+static void cancel_migration(const hashset_t *const set)
+{
+    hs_header_t *header = get_hs_header(set);
+    if (!atomic_load_explicit(&header->migration, memory_order_relaxed)) return;
+
+    migration_t *const migration = atomic_exchange_explicit(&header->migration, NULL, memory_order_acq_rel);
+    if (!migration) return;
+
+    stop_migration(migration);
+}
+
+
+/*
+* Lets background resize go on only if it grows the table to at least
+* `min_cap` slots, otherwise cancels it. Returns true when it goes on.
+*/
+static bool keep_migration(const hashset_t *const set, const size_t min_cap)
+{
+    hs_header_t *header = get_hs_header(set);
+    if (!atomic_load_explicit(&header->migration, memory_order_relaxed)) return false;
+
+    migration_t *const migration = atomic_exchange_explicit(&header->migration, NULL, memory_order_acq_rel);
+    if (!migration) return false;
+
+    pthread_mutex_lock(&migration->lock);
+    const size_t target_cap = hs_capacity(migration->target);
+    const bool grows = !migration->failed && target_cap > hs_capacity(set) && target_cap >= min_cap;
+    pthread_mutex_unlock(&migration->lock);
+
+    if (!grows)
+    {
+        stop_migration(migration);
+        return false;
+    }
+
+    atomic_store_explicit(&header->migration, migration, memory_order_release);
+    return true;
+}
+
+
+/*
+* Joins resize thread of the already claimed migration and drops its copy.
+*/
+static void stop_migration(migration_t *const migration)
+{
+    atomic_store_explicit(&migration->cancel, true, memory_order_relaxed);
+    pthread_join(migration->thread, NULL);
+    pthread_mutex_destroy(&migration->lock);
+
+    hs_destroy(migration->target);
+    free(migration);
+}
+
+
+static bool contained_in(const void *const element, void *const param)
+{
+    const hashset_t *const other = param;
+    return hs_contains(other, element);
+}
+
+
+static bool not_contained_in(const void *const element, void *const param)
+{
+    return !contained_in(element, param);
+}
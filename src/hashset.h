@@ -3,15 +3,68 @@
 
 #include "hash.h"
 #include "vector.h"
+#include <stdint.h>
 
 typedef vector_t hashset_t;
 
+typedef enum hs_probing
+{
+    HS_PROBING_LINEAR = 0, /* open addressing with linear probing */
+    HS_PROBING_CUCKOO      /* bucketized cuckoo hashing, lookup checks two buckets */
+}
+hs_probing_t;
+
+typedef enum hs_numa_policy
+{
+    HS_NUMA_DEFAULT = 0, /* leave placement to the system */
+    HS_NUMA_INTERLEAVE,  /* spread table pages across all allowed nodes */
+    HS_NUMA_BIND         /* keep table pages on `numa_node` */
+}
+hs_numa_policy_t;
+
 typedef struct hs_opts
 {
     size_t value_size;
     size_t initial_cap;
     hashfunc_t hashfunc;
     void *alloc_param;
+
+    /* Collision resolution. Cuckoo mode bounds lookups by two buckets of
+    *  `HS_BUCKET_SLOTS` slots each, capacity is rounded up to whole buckets. */
+    hs_probing_t probing;
+
+    /* Store values at their natural size instead of rounding each slot
+    *  up to `sizeof(size_t)`. Saves memory for small values, but pointers
+    *  handed to predicates (`hs_remove_many`) may be unaligned. */
+    bool packed;
+
+    /* Table is shrunk automatically when the ratio of elements to capacity
+    *  drops below this value on removal (never below `initial_cap`).
+    *  Zero disables automatic shrinking. */
+    float min_load_factor;
+
+    /* Placement hints for large tables (applied when value array spans
+    *  at least one huge page). `huge_pages` requests transparent huge pages,
+    *  `numa_policy` binds or interleaves the table across NUMA nodes.
+    *  Both are best effort and silently ignored when unsupported. */
+    bool huge_pages;
+    hs_numa_policy_t numa_policy;
+    int numa_node;
+
+    /* Bloom filter consulted by `hs_contains` before probing the table.
+    *  `filter_fp_rate` is a desired false positive rate in (0, 1),
+    *  zero disables the filter. `filter_max_bytes` caps its size (0 - no limit). */
+    float filter_fp_rate;
+    size_t filter_max_bytes;
+
+    /* Grow, shrink and tombstone purge are carried out by a helper thread
+    *  (linear probing only). The table is copied while the set stays usable,
+    *  the copy replaces it on the first modification after completion.
+    *  Insertion waits for the copy only when the current table is full.
+    *  Clones share the ongoing copy, it follows the first handle that
+    *  modifies the table. `hs_shrink_reserve` cancels it, so does `hs_reserve`
+    *  unless the copy is a growth large enough for the reservation. */
+    bool background_resize;
 }
 hs_opts_t;
 
@@ -19,10 +72,69 @@ typedef enum hs_status_t
 {
     HS_SUCCESS = VECTOR_SUCCESS,
     HS_ALLOC_ERROR = VECTOR_ALLOC_ERROR,
-    HS_ALREADY_EXISTS = VECTOR_STATUS_LAST
+    HS_ALREADY_EXISTS = VECTOR_STATUS_LAST,
+    HS_COLLISION_ERROR, /* cuckoo: too many values share buckets with the inserted one */
+    HS_INVALID_ARGUMENT
 }
 hs_status_t;
 
+typedef enum hs_view_kind
+{
+    HS_VIEW_UNION,
+    HS_VIEW_INTERSECTION,
+    HS_VIEW_DIFF,
+    HS_VIEW_SYMDIFF
+}
+hs_view_kind_t;
+
+/*
+* Lazy result of a set operation, elements are evaluated on the fly
+* while iterating with `hs_view_next`. View does not own the sets,
+* they must not be modified while the view is in use.
+*/
+typedef struct hs_view
+{
+    hs_view_kind_t kind;
+    const hashset_t *first;
+    const hashset_t *second;
+    size_t slot;  /* next slot to inspect */
+    int stage;    /* 0 - walking `first`, 1 - walking `second` */
+}
+hs_view_t;
+
+/*
+* Quality of a hash function on a sample of values, see `hs_analyze_hash`.
+* Expected probe lengths follow Knuth's estimates for linear probing
+* at the same load factor with an ideal hash.
+*/
+typedef struct hs_hash_report
+{
+    size_t capacity;       /* simulated table size */
+    double load_factor;
+    size_t empty_slots;    /* home slots no value hashed into */
+    size_t max_home_count; /* largest amount of values sharing a home slot */
+    double chi_square;     /* of home slot counts against the uniform distribution */
+    double chi_square_z;   /* deviation in standard deviations, |z| > 3 is suspicious */
+
+    double expected_hit_probes;  /* successful search */
+    double observed_hit_probes;
+    double expected_miss_probes; /* unsuccessful search */
+    double observed_miss_probes;
+    size_t max_probes;           /* longest successful search */
+
+    double hash_ns;        /* average time of a single hashfunc call */
+}
+hs_hash_report_t;
+
+typedef int (*hs_compare_t)(const void *const a, const void *const b);
+
+typedef struct hs_export_opts
+{
+    size_t threads;       /* amount of threads copying the table (at most 64) */
+    hs_compare_t compare; /* when provided, exported values are sorted */
+}
+hs_export_opts_t;
+
 /*
 * The wrapper for `hs_create_` function that provides default values.
 */
@@ -39,19 +151,23 @@ hashset_t *hs_create_(const hs_opts_t *const opts);
 
 
 /*
-* Makes exact copy of the original set.
+* Makes copy of the original set in O(1).
+* Table is shared (copy-on-write) until either of the sets gets modified,
+* so the returned handle may be equal to `set`.
+* Each handle must be released with `hs_destroy`.
 */ 
 hashset_t *hs_clone(const hashset_t *const set);
 
 
 /*
-* Release hashset resources.
+* Release hashset resources (drops a reference to a shared table).
 */
 void hs_destroy(hashset_t *const set);
 
 
 /*
 * Checks if value is a part of the set.
+* When the set has a filter, most misses are rejected without probing the table.
 */
 bool hs_contains(const hashset_t *const set, const void *const value);
 
@@ -59,10 +175,28 @@ bool hs_contains(const hashset_t *const set, const void *const value);
 /*
 * Inserts new value into the set.
 * Returns true when value added and false if it already contained.
+* In cuckoo mode `HS_COLLISION_ERROR` is returned (set left unmodified)
+* when the value doesn't fit even after the table grew once.
 */
 hs_status_t hs_insert(hashset_t **const set, const void *const value);
 
 
+/*
+* Inserts `count` values from contiguous array (stride of `value_size`).
+* Operation is all-or-nothing, on failure the set is left unmodified.
+*/
+hs_status_t hs_insert_many(hashset_t **const set, const void *const values, const size_t count);
+
+
+/*
+* Makes sure that `count` elements fit into the set without rehashing.
+* On failure the set is left unmodified.
+* In cuckoo mode extra slack is reserved, but placement may still
+* rarely require growth.
+*/
+hs_status_t hs_reserve(hashset_t **const set, const size_t count);
+
+
 /*
 * Shrink hashmap and perform rehash,
 * reserving free space portion of currently stored elements
@@ -78,18 +212,23 @@ hs_status_t hs_shrink_reserve(hashset_t **const set, const float reserve);
 /*
 * Remove value from hashset. If there is no such value,
 * then an operation considered successfull.
+* May shrink the set according to `min_load_factor`.
+* Fails with `HS_ALLOC_ERROR` only if shared table can't be copied.
 */
-void hs_remove(hashset_t *const set, const void *const key);
+hs_status_t hs_remove(hashset_t **const set, const void *const key);
 
 
 /*
 * Removes many values that match predicate condition.
+* May shrink the set according to `min_load_factor`.
+* If shared table can't be copied, nothing is removed and 0 returned.
 */ 
-size_t hs_remove_many(hashset_t *const set, const predicate_t predicate, void *const param);
+size_t hs_remove_many(hashset_t **const set, const predicate_t predicate, void *const param);
 
 
 /*
 * Modifies `set` in a way that it will contain union of itself with `other` set. (OR)
+* Operation is all-or-nothing, on failure the set is left unmodified.
 */
 hs_status_t hs_add(hashset_t **const set, const hashset_t *const other);
 
@@ -97,13 +236,13 @@ hs_status_t hs_add(hashset_t **const set, const hashset_t *const other);
 /*
 * Modifies `set` in a way that it will contain intersection of itself with `other` set. (AND)
 */
-void hs_intersect(hashset_t **const set, const hashset_t *const other);
+hs_status_t hs_intersect(hashset_t **const set, const hashset_t *const other);
 
 
 /*
 * Modifies `set` by subtracting `other`s set elements. (set - other)
 */
-void hs_subtract(hashset_t **const set, const hashset_t *const other);
+hs_status_t hs_subtract(hashset_t **const set, const hashset_t *const other);
 
 
 /*
@@ -131,6 +270,61 @@ hashset_t *hs_make_diff(hashset_t *const first, const hashset_t *const second);
 hashset_t *hs_make_symdiff(hashset_t *const first, const hashset_t *const second);
 
 
+/*
+* Lazy counterparts of `hs_make_*` functions, no allocations involved.
+*/
+hs_view_t hs_view_union(const hashset_t *const first, const hashset_t *const second);
+hs_view_t hs_view_intersection(const hashset_t *const first, const hashset_t *const second);
+hs_view_t hs_view_diff(const hashset_t *const first, const hashset_t *const second);
+hs_view_t hs_view_symdiff(const hashset_t *const first, const hashset_t *const second);
+
+
+/*
+* Returns pointer to the next element of the view or NULL when exhausted.
+* Pointer refers to the set storage (may be unaligned for packed sets).
+*/
+const void *hs_view_next(hs_view_t *const view);
+
+
+/*
+* Counts remaining elements of the view (consumes it).
+*/
+size_t hs_view_count(hs_view_t *const view);
+
+
+/*
+* Returns amount of elements present in both sets.
+*/
+size_t hs_intersection_count(const hashset_t *const first, const hashset_t *const second);
+
+
+/*
+* Checks if every element of `set` is contained in `other`. (set <= other)
+*/
+bool hs_is_subset(const hashset_t *const set, const hashset_t *const other);
+
+
+/*
+* Checks if sets have no elements in common.
+*/
+bool hs_is_disjoint(const hashset_t *const first, const hashset_t *const second);
+
+
+/*
+* Checks if both sets contain exactly the same elements.
+* Sets with different counts, or different digests under the same hashfunc,
+* are rejected in O(1).
+*/
+bool hs_equal(const hashset_t *const first, const hashset_t *const second);
+
+
+/*
+* Returns order-independent digest of the set contents (sum of mixed element hashes),
+* maintained incrementally. Equal sets with the same hashfunc have equal digests.
+*/
+uint64_t hs_digest(const hashset_t *const set);
+
+
 /*
 * Returns current set capacity.
 */
@@ -149,4 +343,66 @@ size_t hs_count(const hashset_t *const set);
 vector_t *hs_values(const hashset_t *const set);
 
 
+/*
+* The wrapper for `hs_export_` function that provides default values.
+*/
+#define hs_export(set, buffer, ...) \
+    hs_export_(set, buffer, &(hs_export_opts_t){ \
+        .threads = 1, \
+        __VA_ARGS__ \
+    })
+
+/*
+* Writes set values into caller supplied `buffer` that holds
+* at least `hs_count(set)` values of `value_size` bytes (no padding in between).
+* Large tables are split between `threads`, optionally sorted with `compare`.
+* Returns amount of values written.
+*/
+size_t hs_export_(const hashset_t *const set, void *const buffer, const hs_export_opts_t *const opts);
+
+
+/*
+* Merge-join set operations over sorted arrays of unique values
+* (e.g. made by `hs_export` with `.compare`). Results are written sorted into `out`,
+* which must have room for `a_len + b_len` values (union, symdiff),
+* `min(a_len, b_len)` (intersection) or `a_len` (diff) values.
+* Sorted results can be turned back into a set with `hs_insert_many`.
+* Return amount of values written.
+*/
+size_t hs_sorted_union(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out);
+
+size_t hs_sorted_intersection(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out);
+
+size_t hs_sorted_diff(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out);
+
+size_t hs_sorted_symdiff(const void *const a, const size_t a_len,
+        const void *const b, const size_t b_len,
+        const size_t value_size, const hs_compare_t compare, void *const out);
+
+
+/*
+* Returns amount of bytes occupied by the set storage
+* (header, usage table and value slots).
+*/
+size_t hs_memory_usage(const hashset_t *const set);
+
+
+/*
+* Evaluates `hashfunc` on `count` distinct values of `value_size` bytes laid out
+* contiguously, as if they were inserted into a linear probing set of `capacity`
+* slots (0 - the power of two keeping the load at or below 0.5).
+* Fills the `report`, `HS_INVALID_ARGUMENT` is returned when `capacity`
+* leaves no free slot for the values.
+*/
+hs_status_t hs_analyze_hash(const void *const values, const size_t count,
+        const size_t value_size, const hashfunc_t hashfunc,
+        size_t capacity, hs_hash_report_t *const report);
+
+
 #endif/*_HASHSET_H_*/
@@ -0,0 +1,161 @@
+#ifndef _HASHSET_TYPED_H_
+#define _HASHSET_TYPED_H_
+
+#include "hashset.h"
+#include "bitset.h"
+#include <stdint.h>
+#include <string.h>
+
+#define HS_USAGE_BITS 2        /* slot status bits in the usage table */
+#define HS_LARGE_PRIME 0x7fffffffu
+#define HS_BUCKET_SLOTS 4      /* slots per bucket in cuckoo mode */
+
+typedef enum hs_slot_status
+{
+    HS_SLOT_UNUSED = 0,
+    HS_SLOT_USED,
+    HS_SLOT_DELETED
+}
+hs_slot_status_t;
+
+/*
+* Read-only description of the set table, valid until the set is modified.
+*/
+typedef struct hs_layout
+{
+    const char *usage_tbl;
+    const char *values;
+    size_t capacity;
+    size_t element_size;
+    hs_probing_t probing;
+    unsigned int a;
+    unsigned int b;
+}
+hs_layout_t;
+
+
+/*
+* Returns layout of the set table, to be fetched once for a batch of lookups.
+*/
+hs_layout_t hs_layout(const hashset_t *const set);
+
+
+/*
+* Same as `hs_insert` and `hs_remove`, but take precomputed hash of the value,
+* which must be equal to the one produced by set's hashfunc.
+*/
+hs_status_t hs_insert_hashed(hashset_t **const set, const void *const value, const hash_t hash);
+hs_status_t hs_remove_hashed(hashset_t **const set, const void *const value, const hash_t hash);
+
+
+/*
+* Consults only the bloom filter of the set: false means the value with such
+* hash is definitely absent. Always true when the set has no filter.
+*/
+bool hs_filter_test_hashed(const hashset_t *const set, const hash_t hash);
+
+
+/*
+* Converts hash into the first slot of the probe sequence. (a*h + b) mod p mod c
+*/
+static inline size_t hs_hash_to_index(const unsigned int a, const unsigned int b,
+        const hash_t hash, const size_t capacity)
+{
+    return ((a * hash + b) % HS_LARGE_PRIME) % capacity;
+}
+
+
+/*
+* Second bucket of the value in cuckoo mode, always differs from the `first`
+* when there is more than one bucket.
+*/
+static inline size_t hs_cuckoo_alt_bucket(const size_t first, const hash_t hash, const size_t buckets)
+{
+    if (buckets < 2) return first;
+
+    const uint64_t scrambled = ((uint64_t)hash * 0x9e3779b97f4a7c15ull) >> 33;
+    return (first + 1 + scrambled % (buckets - 1)) % buckets;
+}
+
+
+/*
+* Declares typed interface over the set of `type` values:
+*   bool        name##_contains(const hashset_t *set, const type value);
+*   bool        name##_contains_in(const hs_layout_t *layout, const type value);
+*   hs_status_t name##_insert(hashset_t **set, const type value);
+*   hs_status_t name##_remove(hashset_t **set, const type value);
+*
+* `hash_fn` - `hash_t (const type *)`, must produce the same hash as the
+*             set's hashfunc for `sizeof(type)` bytes;
+* `eq_fn`   - `bool (const type *, const type *)`, must agree with bytewise
+*             comparison (use types without padding).
+*
+* Lookups are probed inline, modifications skip the indirect hashfunc call.
+* Batches of lookups should fetch `hs_layout` once and use `name##_contains_in`.
+*/
+#define HS_DECLARE(name, type, hash_fn, eq_fn) \
+    static inline bool name##_in_slot(const hs_layout_t *const layout, const size_t index, \
+            const type *const value) \
+    { \
+        type stored; /* slots of packed sets may be unaligned */ \
+        memcpy(&stored, layout->values + index * layout->element_size, sizeof(type)); \
+        return eq_fn(&stored, value); \
+    } \
+    \
+    static inline bool name##_contains_in(const hs_layout_t *const layout, const type value) \
+    { \
+        const hash_t hash = hash_fn(&value); \
+        \
+        if (HS_PROBING_CUCKOO == layout->probing) \
+        { \
+            const size_t buckets = layout->capacity / HS_BUCKET_SLOTS; \
+            const size_t first = hs_hash_to_index(layout->a, layout->b, hash, buckets); \
+            const size_t candidates[2] = {first, hs_cuckoo_alt_bucket(first, hash, buckets)}; \
+            \
+            for (size_t b = 0; b < 2; ++b) \
+            { \
+                for (size_t s = 0; s < HS_BUCKET_SLOTS; ++s) \
+                { \
+                    const size_t index = candidates[b] * HS_BUCKET_SLOTS + s; \
+                    if (HS_SLOT_USED == bitset_test(layout->usage_tbl, HS_USAGE_BITS, index) \
+                        && name##_in_slot(layout, index, &value)) return true; \
+                } \
+            } \
+            return false; \
+        } \
+        \
+        size_t index = hs_hash_to_index(layout->a, layout->b, hash, layout->capacity); \
+        \
+        for (size_t i = 0; i < layout->capacity; ++i, ++index) \
+        { \
+            if (index == layout->capacity) index = 0; \
+            \
+            switch (bitset_test(layout->usage_tbl, HS_USAGE_BITS, index)) \
+            { \
+                case HS_SLOT_UNUSED: return false; \
+                case HS_SLOT_DELETED: continue; \
+                default: break; \
+            } \
+            \
+            if (name##_in_slot(layout, index, &value)) return true; \
+        } \
+        return false; \
+    } \
+    \
+    static inline bool name##_contains(const hashset_t *const set, const type value) \
+    { \
+        const hs_layout_t layout = hs_layout(set); \
+        return name##_contains_in(&layout, value); \
+    } \
+    \
+    static inline hs_status_t name##_insert(hashset_t **const set, const type value) \
+    { \
+        return hs_insert_hashed(set, &value, hash_fn(&value)); \
+    } \
+    \
+    static inline hs_status_t name##_remove(hashset_t **const set, const type value) \
+    { \
+        return hs_remove_hashed(set, &value, hash_fn(&value)); \
+    }
+
+#endif/*_HASHSET_TYPED_H_*/
@@ -1,7 +1,12 @@
 #include "../src/hashset.h"
+#include "../src/hashset_typed.h"
 #include <check.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static hashset_t *set;
 static hashset_t *other;
@@ -147,6 +152,155 @@ START_TEST (test_hs_insert_rehash)
 END_TEST
 
 
+START_TEST (test_hs_insert_many)
+{
+    const int values[] = {1, 2, 3, 3, 2, 1, 4, 5};
+    const size_t amount = sizeof(values) / sizeof(*values);
+
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert_many(&set, values, amount));
+    ck_assert_uint_eq(hs_count(set), 5);
+
+    ck_assert_uint_eq(HS_SUCCESS, hs_reserve(&set, 1000));
+    ck_assert_uint_eq(hs_capacity(set), 1024);
+    ck_assert_uint_eq(hs_count(set), 5);
+
+    for (int i = 1; i <= 5; ++i)
+    {
+        ck_assert(hs_contains(set, &i));
+    }
+}
+END_TEST
+
+
+static inline hash_t int_hash(const int *const value)
+{
+    return hash_int(value, sizeof(int));
+}
+
+static inline bool int_eq(const int *const a, const int *const b)
+{
+    return *a == *b;
+}
+
+HS_DECLARE(int_set, int, int_hash, int_eq)
+
+START_TEST (test_hs_typed)
+{
+    for (int i = 0; i < 300; ++i) /* forces rehash */
+    {
+        ck_assert_uint_eq(HS_SUCCESS, int_set_insert(&set, i));
+    }
+    ck_assert_uint_eq(HS_ALREADY_EXISTS, int_set_insert(&set, 7));
+    ck_assert_uint_eq(hs_count(set), 300);
+
+    /* layout fetched once serves the whole batch */
+    const hs_layout_t layout = hs_layout(set);
+    for (int i = 0; i < 300; ++i)
+    {
+        ck_assert(int_set_contains_in(&layout, i));
+        ck_assert(int_set_contains(set, i));
+        ck_assert(hs_contains(set, &i)); /* same table layout */
+    }
+    ck_assert(!int_set_contains_in(&layout, 300));
+    ck_assert(!int_set_contains(set, 300));
+
+    ck_assert_uint_eq(HS_SUCCESS, int_set_remove(&set, 7));
+    ck_assert(!int_set_contains(set, 7));
+    ck_assert(!hs_contains(set, TMP_REF(int, 7)));
+    ck_assert(int_set_contains(set, 8));
+}
+END_TEST
+
+
+static hash_t const_hash(const void *const value, const size_t size)
+{
+    (void) value;
+    (void) size;
+    return 42;
+}
+
+START_TEST (test_hs_cuckoo)
+{
+    hashset_t *cuckoo = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = 10,
+        .probing = HS_PROBING_CUCKOO
+    );
+    ck_assert_ptr_nonnull(cuckoo);
+    ck_assert_uint_eq(hs_capacity(cuckoo), 12); /* whole buckets */
+
+    const int amount = 10000;
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&cuckoo, &i));
+    }
+    ck_assert_uint_eq(HS_ALREADY_EXISTS, hs_insert(&cuckoo, TMP_REF(int, 42)));
+    ck_assert_uint_eq(hs_count(cuckoo), amount);
+
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert(hs_contains(cuckoo, &i));
+        ck_assert(int_set_contains(cuckoo, i));
+    }
+    ck_assert(!hs_contains(cuckoo, &amount));
+    ck_assert(!int_set_contains(cuckoo, amount));
+
+    for (int i = 0; i < amount; i += 2)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_remove(&cuckoo, &i));
+    }
+    ck_assert_uint_eq(hs_count(cuckoo), amount / 2);
+    ck_assert(!hs_contains(cuckoo, TMP_REF(int, 0)));
+    ck_assert(hs_contains(cuckoo, TMP_REF(int, 1)));
+
+    /* set algebra is shared with linear mode */
+    for (int i = 1; i <= 10; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&set, &i));
+    }
+    ck_assert_uint_eq(hs_intersection_count(cuckoo, set), 5);
+    ck_assert_uint_eq(HS_SUCCESS, hs_add(&cuckoo, set));
+    ck_assert_uint_eq(hs_count(cuckoo), amount / 2 + 5);
+
+    hs_destroy(cuckoo);
+
+    /* equal hashes fit only into their two buckets, growth doesn't help */
+    hashset_t *colliding = hs_create(.value_size = sizeof(int),
+        .hashfunc = const_hash,
+        .initial_cap = 16,
+        .probing = HS_PROBING_CUCKOO
+    );
+    for (int i = 0; i < 2 * HS_BUCKET_SLOTS; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&colliding, &i));
+    }
+    ck_assert_uint_eq(HS_COLLISION_ERROR, hs_insert(&colliding, TMP_REF(int, 100)));
+    ck_assert_uint_eq(16, hs_capacity(colliding));
+
+    /* bulk inserts are all-or-nothing */
+    const int more[] = {0, 100, 101};
+    ck_assert_uint_eq(HS_COLLISION_ERROR, hs_insert_many(&colliding, more, 3));
+    ck_assert_uint_eq(HS_COLLISION_ERROR, hs_add(&colliding, set));
+    ck_assert_uint_eq(2 * HS_BUCKET_SLOTS, hs_count(colliding));
+    ck_assert_uint_eq(16, hs_capacity(colliding));
+    ck_assert(!hs_contains(colliding, TMP_REF(int, 100)));
+
+    /* values placed before the failing one are taken back */
+    ck_assert_uint_eq(HS_SUCCESS, hs_remove(&colliding, TMP_REF(int, 0)));
+    ck_assert_uint_eq(HS_COLLISION_ERROR, hs_insert_many(&colliding, more, 3));
+    ck_assert_uint_eq(2 * HS_BUCKET_SLOTS - 1, hs_count(colliding));
+    ck_assert(!hs_contains(colliding, TMP_REF(int, 0)));
+    ck_assert(!hs_contains(colliding, TMP_REF(int, 100)));
+    for (int i = 1; i < 2 * HS_BUCKET_SLOTS; ++i)
+    {
+        ck_assert(hs_contains(colliding, &i));
+    }
+
+    hs_destroy(colliding);
+}
+END_TEST
+
+
 static bool exact(const void *const element, void *const param)
 {
     return *(int*) element == *(int*) param;
@@ -175,6 +329,346 @@ START_TEST (test_hs_values)
 END_TEST
 
 
+START_TEST (test_hs_background_resize)
+{
+    enum { N = 100000 };
+    hashset_t *bg = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = 64,
+        .min_load_factor = 0.1f,
+        .background_resize = true
+    );
+    hashset_t *ref = hs_create(.value_size = sizeof(int), .hashfunc = hash_int);
+
+    for (int i = 0; i < N; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&bg, &i));
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&ref, &i));
+        if (i % 10000 == 0)
+        {
+            /* snapshot is not affected by the copy following the modified handle */
+            hashset_t *snapshot = hs_clone(bg);
+            const int next = N + i;
+            ck_assert_uint_eq(HS_SUCCESS, hs_insert(&bg, &next));
+            ck_assert(!hs_contains(snapshot, &next));
+            ck_assert(hs_equal(snapshot, ref));
+            ck_assert_uint_eq(HS_SUCCESS, hs_remove(&bg, &next));
+            hs_destroy(snapshot);
+        }
+    }
+    ck_assert_uint_eq(N, hs_count(bg));
+    ck_assert(hs_equal(bg, ref));
+
+    /* removals land in both the table and its copy */
+    for (int i = 0; i < N; i += 2)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_remove(&bg, &i));
+        ck_assert_uint_eq(HS_SUCCESS, hs_remove(&ref, &i));
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        ck_assert(hs_contains(bg, &i) == (i % 2 == 1));
+    }
+    ck_assert(hs_equal(bg, ref));
+
+    /* churn: tombstones get purged, set stays usable */
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 1; i < N; i += 2)
+        {
+            ck_assert_uint_eq(HS_SUCCESS, hs_remove(&bg, &i));
+        }
+        ck_assert_uint_eq(0, hs_count(bg));
+        for (int i = 1; i < N; i += 2)
+        {
+            ck_assert_uint_eq(HS_SUCCESS, hs_insert(&bg, &i));
+        }
+    }
+    ck_assert(hs_equal(bg, ref));
+
+    /* reserved capacity is not taken back by a pending shrink */
+    for (int i = 1; i < N; i += 2)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_remove(&bg, &i));
+    }
+    ck_assert_uint_eq(HS_SUCCESS, hs_reserve(&bg, N));
+    const size_t reserved = hs_capacity(bg);
+    ck_assert_uint_ge(reserved, N);
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert(&bg, TMP_REF(int, 1)));
+    ck_assert_uint_eq(reserved, hs_capacity(bg));
+
+    hs_destroy(ref);
+    hs_destroy(bg); /* may still be resizing */
+}
+END_TEST
+
+static pthread_t test_thread;
+static atomic_size_t resize_hashes;
+
+/* slow on the resize thread, so the copy is still in progress while the test goes on */
+static hash_t resize_counting_hash(const void *const value, const size_t size)
+{
+    if (!pthread_equal(pthread_self(), test_thread))
+    {
+        atomic_fetch_add(&resize_hashes, 1);
+        nanosleep(&(struct timespec){ .tv_nsec = 10000 }, NULL);
+    }
+    return hash_int(value, size);
+}
+
+START_TEST (test_hs_background_reserve)
+{
+    test_thread = pthread_self();
+    atomic_store(&resize_hashes, 0);
+
+    hashset_t *bg = hs_create(.value_size = sizeof(int),
+        .hashfunc = resize_counting_hash,
+        .initial_cap = 4096,
+        .background_resize = true
+    );
+    ck_assert_ptr_nonnull(bg);
+
+    /* the last insert starts growing in the background */
+    const int amount = 3 * 4096 / 4;
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&bg, &i));
+    }
+    while (0 == atomic_load(&resize_hashes))
+    {
+        nanosleep(&(struct timespec){ .tv_nsec = 10000 }, NULL);
+    }
+
+    /* bulk insert fits into the growing table, the copy is not started over */
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert_many(&bg, &amount, 1));
+    while (4096 == hs_capacity(bg))
+    {
+        ck_assert_uint_eq(HS_ALREADY_EXISTS, hs_insert(&bg, TMP_REF(int, 0)));
+        nanosleep(&(struct timespec){ .tv_nsec = 100000 }, NULL);
+    }
+    ck_assert_uint_eq(2 * 4096, hs_capacity(bg));
+    ck_assert_uint_ge(amount + 1, atomic_load(&resize_hashes));
+    for (int i = 0; i <= amount; ++i)
+    {
+        ck_assert(hs_contains(bg, &i));
+    }
+
+    hs_destroy(bg);
+}
+END_TEST
+
+START_TEST (test_hs_packed)
+{
+    hashset_t *packed = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .packed = true
+    );
+    ck_assert_ptr_nonnull(packed);
+
+    /* forces rehash of the packed table */
+    const int amount = (int)hs_capacity(packed) + 1;
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&packed, &i));
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&set, &i));
+    }
+
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert(hs_contains(packed, &i));
+    }
+    ck_assert_uint_eq(hs_count(packed), amount);
+    ck_assert_uint_eq(hs_capacity(packed), hs_capacity(set));
+    ck_assert_uint_lt(hs_memory_usage(packed), hs_memory_usage(set));
+
+    hs_destroy(packed);
+}
+END_TEST
+
+static hash_t hash_aligned_triple(const void *const value, const size_t size)
+{
+    ck_assert_uint_eq(0, (uintptr_t)value % sizeof(size_t));
+    return hash_int(value, size);
+}
+
+START_TEST (test_hs_packed_source)
+{
+    typedef struct { int v[3]; } triple_t;
+    hashset_t *packed = hs_create(.value_size = sizeof(triple_t),
+        .hashfunc = hash_aligned_triple,
+        .packed = true
+    );
+    hashset_t *aligned = hs_create(.value_size = sizeof(triple_t),
+        .hashfunc = hash_aligned_triple
+    );
+    ck_assert_ptr_nonnull(packed);
+    ck_assert_ptr_nonnull(aligned);
+
+    for (int i = 0; i < 50; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&packed, &(triple_t){{i, i, i}}));
+    }
+
+    /* values of the packed source reach the hashfunc aligned */
+    ck_assert_uint_eq(HS_SUCCESS, hs_add(&aligned, packed));
+    ck_assert(hs_is_subset(packed, aligned));
+    ck_assert(hs_equal(aligned, packed));
+
+    hs_destroy(aligned);
+    hs_destroy(packed);
+}
+END_TEST
+
+
+START_TEST (test_hs_filter)
+{
+    hashset_t *filtered = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = 64,
+        .filter_fp_rate = 0.01f
+    );
+    ck_assert_ptr_nonnull(filtered);
+
+    /* forces rehash, filter has to be rebuilt */
+    for (int i = 0; i < 100; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&filtered, &i));
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ck_assert(hs_contains(filtered, &i));
+    }
+
+    /* the filter itself rejects nearly all non-members, so they are never probed */
+    size_t rejected = 0;
+    for (int i = 100; i < 1000; ++i)
+    {
+        ck_assert(!hs_contains(filtered, &i));
+        if (!hs_filter_test_hashed(filtered, hash_int(&i, sizeof(int)))) ++rejected;
+    }
+    ck_assert_uint_ge(rejected, 900 * 95 / 100);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ck_assert(hs_filter_test_hashed(filtered, hash_int(&i, sizeof(int))));
+    }
+    ck_assert(hs_filter_test_hashed(set, hash_int(TMP_REF(int, 1000), sizeof(int))));
+
+    hs_remove(&filtered, TMP_REF(int, 50));
+    ck_assert(!hs_contains(filtered, TMP_REF(int, 50)));
+
+    hs_destroy(filtered);
+}
+END_TEST
+
+
+START_TEST (test_hs_placement)
+{
+    /* large enough for placement hints to be applied */
+    const size_t cap = (4u << 20) / sizeof(size_t);
+    hashset_t *large = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = cap,
+        .huge_pages = true,
+        .numa_policy = HS_NUMA_INTERLEAVE
+    );
+    ck_assert_ptr_nonnull(large);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&large, &i));
+    }
+
+    /* modification copies the shared table, placement is applied to the copy */
+    hashset_t *clone = hs_clone(large);
+    ck_assert_ptr_nonnull(clone);
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert(&clone, TMP_REF(int, 1000)));
+    ck_assert(clone != large);
+    ck_assert_uint_eq(cap, hs_capacity(clone));
+    ck_assert(!hs_contains(large, TMP_REF(int, 1000)));
+    ck_assert(hs_is_subset(large, clone));
+
+    ck_assert_uint_eq(HS_SUCCESS, hs_remove(&clone, TMP_REF(int, 1000)));
+    ck_assert(hs_equal(clone, large));
+
+    hs_destroy(clone);
+    hs_destroy(large);
+}
+END_TEST
+
+
+static int compare_int(const void *const a, const void *const b)
+{
+    return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b);
+}
+
+START_TEST (test_hs_analyze_hash)
+{
+    enum { N = 1000 };
+    int values[N];
+    for (int i = 0; i < N; ++i)
+    {
+        values[i] = i;
+    }
+
+    hs_hash_report_t good, bad;
+    ck_assert_uint_eq(HS_SUCCESS, hs_analyze_hash(values, N, sizeof(int), hash_int, 0, &good));
+    ck_assert_uint_eq(HS_SUCCESS, hs_analyze_hash(values, N, sizeof(int), const_hash, 4096, &bad));
+
+    ck_assert_uint_eq(HS_INVALID_ARGUMENT, hs_analyze_hash(values, N, sizeof(int), hash_int, N, &bad));
+
+    ck_assert_uint_eq(2048, good.capacity);
+    ck_assert_uint_eq(4096, bad.capacity);
+    ck_assert(good.load_factor > 0.48 && good.load_factor < 0.49);
+    ck_assert(good.hash_ns > 0.0);
+
+    /* everything collides into one home slot */
+    ck_assert_uint_eq(N, bad.max_home_count);
+    ck_assert_uint_eq(4096 - 1, bad.empty_slots);
+    ck_assert_uint_eq(N, bad.max_probes);
+    ck_assert(bad.chi_square_z > 100.0);
+    ck_assert(bad.observed_hit_probes > 10 * bad.expected_hit_probes);
+    ck_assert(bad.observed_miss_probes > 10 * bad.expected_miss_probes);
+
+    ck_assert(good.chi_square_z < bad.chi_square_z);
+    ck_assert(good.max_home_count < 10);
+    ck_assert(good.observed_hit_probes < 2 * good.expected_hit_probes);
+    ck_assert(good.observed_miss_probes < 2 * good.expected_miss_probes);
+}
+END_TEST
+
+START_TEST (test_hs_export)
+{
+    const int amount = 50000; /* large enough to be split between threads */
+    for (int i = amount - 1; i >= 0; --i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&set, &i));
+    }
+
+    int *buffer = malloc(amount * sizeof(int));
+    ck_assert_ptr_nonnull(buffer);
+
+    ck_assert_uint_eq(hs_export(set, buffer, .threads = 4, .compare = compare_int), amount);
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert_int_eq(buffer[i], i);
+    }
+
+    /* unsorted export contains the same values */
+    memset(buffer, 0, amount * sizeof(int));
+    ck_assert_uint_eq(hs_export(set, buffer, .threads = 3), amount);
+    qsort(buffer, amount, sizeof(int), compare_int);
+    for (int i = 0; i < amount; ++i)
+    {
+        ck_assert_int_eq(buffer[i], i);
+    }
+
+    free(buffer);
+}
+END_TEST
+
+
 /****************************************************
 *  Test Case: Remove
 *   (use with `setup_full` fixture)
@@ -187,7 +681,7 @@ START_TEST (test_hs_remove)
     // delete all
     for (int i = 0; i < cap; ++i)
     {
-        hs_remove(set, &i);
+        hs_remove(&set, &i);
         ck_assert(!hs_contains(set, &i));
     }
 
@@ -196,6 +690,72 @@ START_TEST (test_hs_remove)
 END_TEST
 
 
+START_TEST (test_hs_remove_reinsert)
+{
+    const int cap = (int)hs_capacity(set);
+
+    for (int i = 0; i < cap / 2; ++i)
+    {
+        hs_remove(&set, &i);
+    }
+
+    /* deleted slots must not hide values further in the probe sequence */
+    size_t inserted = 0;
+    for (int i = 0; i < cap; ++i)
+    {
+        if (HS_SUCCESS == hs_insert(&set, &i)) ++inserted;
+    }
+
+    ck_assert_uint_eq(inserted, cap / 2);
+    ck_assert_uint_eq(hs_count(set), cap);
+}
+END_TEST
+
+
+START_TEST (test_hs_auto_shrink)
+{
+    hashset_t *sparse = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = 16,
+        .min_load_factor = 0.25f
+    );
+    ck_assert_ptr_nonnull(sparse);
+
+    for (int i = 0; i < 1024; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&sparse, &i));
+    }
+    ck_assert_uint_eq(hs_capacity(sparse), 1024);
+
+    for (int i = 10; i < 1024; ++i)
+    {
+        hs_remove(&sparse, &i);
+    }
+
+    /* shrunk, but load stays well below the grow point */
+    const size_t cap = hs_capacity(sparse);
+    ck_assert_uint_lt(cap, 1024);
+    ck_assert_uint_ge(cap, 16);
+    ck_assert_uint_eq(hs_count(sparse), 10);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ck_assert(hs_contains(sparse, &i));
+    }
+
+    /* never goes below initial capacity */
+    for (int i = 0; i < 10; ++i)
+    {
+        hs_remove(&sparse, &i);
+    }
+    ck_assert_uint_eq(hs_capacity(sparse), 16);
+    ck_assert_uint_eq(hs_count(sparse), 0);
+
+    hs_destroy(sparse);
+}
+END_TEST
+
+
 static bool even(const void *const element, void *param)
 {
     (void) param;
@@ -205,7 +765,7 @@ static bool even(const void *const element, void *param)
 START_TEST (test_hs_remove_many)
 {
     const size_t cap = hs_capacity(set);
-    size_t remove_count = hs_remove_many(set, even, NULL); /* removes all even numbers */
+    size_t remove_count = hs_remove_many(&set, even, NULL); /* removes all even numbers */
 
     ck_assert_uint_eq(remove_count, cap / 2);
     ck_assert_uint_eq(hs_count(set), cap / 2);
@@ -284,6 +844,151 @@ START_TEST (test_hs_make_symdiff)
 END_TEST
 
 
+START_TEST (test_hs_views)
+{
+    hs_view_t view = hs_view_union(set, other);
+    ck_assert_uint_eq(hs_view_count(&view), 15);
+
+    view = hs_view_intersection(set, other);
+    const int *value;
+    size_t count = 0;
+    while ((value = hs_view_next(&view)))
+    {
+        ck_assert(*value >= 5 && *value <= 10);
+        ++count;
+    }
+    ck_assert_uint_eq(count, 6);
+
+    view = hs_view_diff(set, other);
+    ck_assert_uint_eq(hs_view_count(&view), 4);
+
+    view = hs_view_symdiff(set, other);
+    ck_assert_uint_eq(hs_view_count(&view), 9);
+
+    ck_assert_uint_eq(hs_intersection_count(set, other), 6);
+    ck_assert(!hs_is_disjoint(set, other));
+    ck_assert(!hs_is_subset(set, other));
+
+    hs_subtract(&set, other);
+    ck_assert(hs_is_disjoint(set, other));
+    ck_assert(hs_is_subset(set, set));
+}
+END_TEST
+
+START_TEST (test_hs_equal)
+{
+    ck_assert(!hs_equal(set, other));
+    ck_assert(hs_equal(set, set));
+
+    hashset_t *copy = hs_create(.value_size = sizeof(int),
+        .hashfunc = hash_int,
+        .initial_cap = 64
+    );
+    ck_assert_ptr_nonnull(copy);
+
+    /* different insertion order and capacity */
+    for (int i = 10; i >= 1; --i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&copy, &i));
+    }
+    ck_assert_uint_eq(hs_digest(copy), hs_digest(set));
+    ck_assert(hs_equal(copy, set));
+    ck_assert(hs_is_subset(copy, set));
+
+    hs_remove(&copy, TMP_REF(int, 3));
+    ck_assert_uint_ne(hs_digest(copy), hs_digest(set));
+    ck_assert(!hs_equal(copy, set));
+    ck_assert(hs_is_subset(copy, set));
+
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert(&copy, TMP_REF(int, 3)));
+    ck_assert(hs_equal(copy, set));
+
+    /* digests of different hashfuncs are not comparable */
+    hashset_t *rehashed = hs_create(.value_size = sizeof(int), .hashfunc = const_hash);
+    for (int i = 1; i <= 10; ++i)
+    {
+        ck_assert_uint_eq(HS_SUCCESS, hs_insert(&rehashed, &i));
+    }
+    ck_assert(hs_equal(rehashed, set));
+    ck_assert(hs_is_subset(set, rehashed));
+
+    hs_destroy(rehashed);
+    hs_destroy(copy);
+}
+END_TEST
+
+START_TEST (test_hs_clone)
+{
+    hashset_t *clone = hs_clone(set);
+    ck_assert_ptr_nonnull(clone);
+    ck_assert(hs_equal(clone, set));
+
+    /* modifications are not visible through the other handle */
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert(&clone, TMP_REF(int, 100)));
+    ck_assert(hs_contains(clone, TMP_REF(int, 100)));
+    ck_assert(!hs_contains(set, TMP_REF(int, 100)));
+
+    hashset_t *snapshot = hs_clone(set);
+    ck_assert_uint_eq(HS_SUCCESS, hs_remove(&set, TMP_REF(int, 1)));
+    ck_assert(!hs_contains(set, TMP_REF(int, 1)));
+    ck_assert(hs_contains(snapshot, TMP_REF(int, 1)));
+    ck_assert_uint_eq(hs_count(snapshot), 10);
+
+    /* set algebra on shared tables */
+    ck_assert_uint_eq(HS_SUCCESS, hs_intersect(&snapshot, other));
+    ck_assert_uint_eq(hs_count(snapshot), 6);
+    ck_assert_uint_eq(hs_count(clone), 11);
+
+    hashset_t *diff = hs_make_diff(clone, other);
+    ck_assert_ptr_nonnull(diff);
+    ck_assert_uint_eq(hs_count(diff), 5);
+
+    hs_destroy(diff);
+    hs_destroy(snapshot);
+    hs_destroy(clone);
+}
+END_TEST
+
+START_TEST (test_hs_sorted_ops)
+{
+    int a[10], b[11], out[21];
+    ck_assert_uint_eq(hs_export(set, a, .compare = compare_int), 10);   /* 1 - 10 */
+    ck_assert_uint_eq(hs_export(other, b, .compare = compare_int), 11); /* 5 - 15 */
+
+    ck_assert_uint_eq(hs_sorted_union(a, 10, b, 11, sizeof(int), compare_int, out), 15);
+    for (int i = 0; i < 15; ++i) ck_assert_int_eq(out[i], i + 1);
+
+    ck_assert_uint_eq(hs_sorted_intersection(a, 10, b, 11, sizeof(int), compare_int, out), 6);
+    for (int i = 0; i < 6; ++i) ck_assert_int_eq(out[i], i + 5);
+
+    ck_assert_uint_eq(hs_sorted_diff(a, 10, b, 11, sizeof(int), compare_int, out), 4);
+    for (int i = 0; i < 4; ++i) ck_assert_int_eq(out[i], i + 1);
+
+    ck_assert_uint_eq(hs_sorted_symdiff(a, 10, b, 11, sizeof(int), compare_int, out), 9);
+    ck_assert_int_eq(out[3], 4);
+    ck_assert_int_eq(out[4], 11);
+
+    /* skewed sizes (over 8x) take the galloping path, in either argument order */
+    int large[100];
+    for (int i = 0; i < 100; ++i) large[i] = 2 * i; /* 0 - 198 even */
+    const int small[] = {-3, 0, 7, 50, 51, 198, 250};
+    const int common[] = {0, 50, 198};
+
+    ck_assert_uint_eq(hs_sorted_intersection(small, 7, large, 100, sizeof(int), compare_int, out), 3);
+    for (int i = 0; i < 3; ++i) ck_assert_int_eq(out[i], common[i]);
+
+    ck_assert_uint_eq(hs_sorted_intersection(large, 100, small, 7, sizeof(int), compare_int, out), 3);
+    for (int i = 0; i < 3; ++i) ck_assert_int_eq(out[i], common[i]);
+
+    /* result back into a set */
+    hashset_t *result = hs_create(.value_size = sizeof(int), .hashfunc = hash_int);
+    ck_assert_ptr_nonnull(result);
+    ck_assert_uint_eq(HS_SUCCESS, hs_insert_many(&result, out, 3));
+    ck_assert(hs_contains(result, TMP_REF(int, 50)));
+    hs_destroy(result);
+}
+END_TEST
+
 
 Suite *hash_set_suite(void)
 {
@@ -300,13 +1005,26 @@ Suite *hash_set_suite(void)
     tcase_add_test(tc_core, test_hs_insert_unique);
     tcase_add_test(tc_core, test_hs_insert_full);
     tcase_add_test(tc_core, test_hs_insert_rehash);
+    tcase_add_test(tc_core, test_hs_insert_many);
+    tcase_add_test(tc_core, test_hs_typed);
+    tcase_add_test(tc_core, test_hs_cuckoo);
     tcase_add_test(tc_core, test_hs_values);
+    tcase_add_test(tc_core, test_hs_export);
+    tcase_add_test(tc_core, test_hs_packed);
+    tcase_add_test(tc_core, test_hs_packed_source);
+    tcase_add_test(tc_core, test_hs_filter);
+    tcase_add_test(tc_core, test_hs_placement);
+    tcase_add_test(tc_core, test_hs_background_resize);
+    tcase_add_test(tc_core, test_hs_background_reserve);
+    tcase_add_test(tc_core, test_hs_analyze_hash);
     suite_add_tcase(s, tc_core);
 
     tc_remove = tcase_create("Remove");
     tcase_add_checked_fixture(tc_remove, setup_full, teardown);
     tcase_add_test(tc_remove, test_hs_remove);
     tcase_add_test(tc_remove, test_hs_remove_many);
+    tcase_add_test(tc_remove, test_hs_remove_reinsert);
+    tcase_add_test(tc_remove, test_hs_auto_shrink);
 
     suite_add_tcase(s, tc_remove);
 
@@ -316,6 +1034,10 @@ Suite *hash_set_suite(void)
     tcase_add_test(tc_operations, test_hs_intersect);
     tcase_add_test(tc_operations, test_hs_subtract);
     tcase_add_test(tc_operations, test_hs_make_symdiff);
+    tcase_add_test(tc_operations, test_hs_views);
+    tcase_add_test(tc_operations, test_hs_equal);
+    tcase_add_test(tc_operations, test_hs_clone);
+    tcase_add_test(tc_operations, test_hs_sorted_ops);
 
     suite_add_tcase(s, tc_operations);
 